@@ -0,0 +1,38 @@
+// Runs one Jeve script many times from C++ with different inputs.
+// Build with -DJEVE_BUILD_EXAMPLES=ON and run ./build/jeve_embed.
+#include "interpreter/JeveInterpreter.hpp"
+#include <iostream>
+
+int main() {
+    jeve::InterpreterOptions options;
+    options.maxHeap = 16 * 1024 * 1024;
+    jeve::JeveInterpreter interpreter(options);
+
+    // Parsed once; the interpreter keeps the program
+    jeve::Program& script = interpreter.load(R"(
+        function score(values) {
+            total = 0;
+            for i, v in values {
+                total = total + v * weight;
+            }
+            return total;
+        }
+        best = score(input);
+        return best > limit;
+    )");
+
+    for (int64_t weight = 1; weight <= 3; ++weight) {
+        interpreter.setGlobal("input", jeve::Value(std::vector<jeve::Value>{jeve::Value(int64_t(4)), jeve::Value(int64_t(5))}));
+        interpreter.setGlobal("weight", jeve::Value(weight));
+        interpreter.setGlobal("limit", jeve::Value(int64_t(20)));
+        try {
+            jeve::Value over = interpreter.execute(script);
+            std::cout << "weight " << weight << ": best = " << interpreter.getGlobal("best").toString()
+                      << ", over limit = " << over.toString() << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Script failed: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
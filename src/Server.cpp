@@ -0,0 +1,429 @@
+#include "Server.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace jeve {
+namespace server {
+
+#if defined(_WIN32)
+
+std::string defaultSocketPath() { return std::string(); }
+
+int serve(const Config&) {
+    std::cerr << "Error: --serve needs Unix domain sockets, which this platform does not provide" << std::endl;
+    return 1;
+}
+
+int runClient(const std::string&, const std::vector<std::string>&) {
+    std::cerr << "Error: --client needs Unix domain sockets, which this platform does not provide" << std::endl;
+    return 1;
+}
+
+#else
+
+namespace {
+
+// Scripts and output chunks are far smaller; anything bigger is a broken peer
+constexpr uint32_t MAX_FRAME = 1u << 30;
+// A client must send its whole request within this long, or it is dropped
+// so it cannot keep a worker waiting
+constexpr std::chrono::seconds REQUEST_TIMEOUT(10);
+
+using Clock = std::chrono::steady_clock;
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Fails once the deadline passes before everything has arrived
+bool readAll(int fd, char* data, size_t size, Clock::time_point deadline = Clock::time_point::max()) {
+    while (size > 0) {
+        if (deadline != Clock::time_point::max()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+            if (left.count() <= 0) return false;
+            pollfd waiting{fd, POLLIN, 0};
+            int ready = ::poll(&waiting, 1, static_cast<int>(std::min<long long>(left.count(), 60000)));
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0) return false;
+            if (ready == 0) continue;
+        }
+        ssize_t got = ::read(fd, data, size);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeFrame(int fd, Frame type, const char* data, size_t size) {
+    char header[5];
+    header[0] = static_cast<char>(type);
+    uint32_t length = static_cast<uint32_t>(size);
+    std::memcpy(header + 1, &length, sizeof(length));
+    return writeAll(fd, header, sizeof(header)) && writeAll(fd, data, size);
+}
+
+bool writeFrame(int fd, Frame type, const std::string& payload) {
+    return writeFrame(fd, type, payload.data(), payload.size());
+}
+
+bool readFrame(int fd, Frame& type, std::string& payload, Clock::time_point deadline = Clock::time_point::max()) {
+    char header[5];
+    if (!readAll(fd, header, sizeof(header), deadline)) return false;
+    uint32_t length;
+    std::memcpy(&length, header + 1, sizeof(length));
+    if (length > MAX_FRAME) return false;
+    type = static_cast<Frame>(header[0]);
+    payload.resize(length);
+    return length == 0 || readAll(fd, &payload[0], length, deadline);
+}
+
+bool makeAddress(const std::string& path, sockaddr_un& address) {
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connectTo(const std::string& path) {
+    sockaddr_un address;
+    if (!makeAddress(path, address)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// True if the process at the other end of a connected socket runs as this
+// user. Socket permissions alone do not protect a client: anyone could have
+// bound the path first.
+bool peerIsOwner(int fd) {
+#if defined(SO_PEERCRED)
+    ucred credentials;
+    socklen_t size = sizeof(credentials);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0) return false;
+    return credentials.uid == ::getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (::getpeereid(fd, &uid, &gid) != 0) return false;
+    return uid == ::getuid();
+#endif
+}
+
+// Sends everything written to it as frames of one type. Output is flushed
+// on every std::endl, so the client sees each line as soon as it is printed.
+class FrameBuffer : public std::streambuf {
+private:
+    int fd;
+    Frame type;
+    char buffer[4096];
+    bool broken = false;  // the client went away; keep running but drop output
+
+    bool send() {
+        size_t size = static_cast<size_t>(pptr() - pbase());
+        if (size > 0 && !broken && !writeFrame(fd, type, pbase(), size)) {
+            broken = true;
+        }
+        setp(buffer, buffer + sizeof(buffer));
+        return !broken;
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        send();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override { return send() ? 0 : -1; }
+
+public:
+    FrameBuffer(int socket, Frame frameType) : fd(socket), type(frameType) {
+        setp(buffer, buffer + sizeof(buffer));
+    }
+};
+
+struct Script {
+    std::string name;
+    std::string code;
+    bool readable = true;
+};
+
+// Reads one request; returns false if the client hung up, sent garbage or
+// took too long
+bool readRequest(int fd, std::vector<Script>& scripts) {
+    Clock::time_point deadline = Clock::now() + REQUEST_TIMEOUT;
+    Frame type;
+    std::string payload;
+    while (readFrame(fd, type, payload, deadline)) {
+        switch (type) {
+            case Frame::Run:
+                return true;
+            case Frame::Source:
+                scripts.push_back({"<stdin>", std::move(payload), true});
+                break;
+            case Frame::File: {
+                Script script{payload, std::string(), false};
+                std::ifstream file(payload, std::ios::binary);
+                if (file) {
+                    script.code.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                    script.readable = true;
+                }
+                scripts.push_back(std::move(script));
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+void handleClient(int fd, const Config& config, std::unique_ptr<JeveInterpreter>& ready) {
+    // The server runs any script it is sent, so only its owner may send one
+    if (!peerIsOwner(fd)) return;
+    std::vector<Script> scripts;
+    if (!readRequest(fd, scripts)) return;
+
+    FrameBuffer outBuffer(fd, Frame::Out);
+    FrameBuffer errBuffer(fd, Frame::Err);
+    std::ostream out(&outBuffer);
+    std::ostream err(&errBuffer);
+    int status = 0;
+    for (Script& script : scripts) {
+        if (!script.readable) {
+            err << "Error: Could not open file: " << script.name << std::endl;
+            status = 1;
+            continue;
+        }
+        try {
+            if (!ready) ready = config.prepare();
+        } catch (const std::exception& e) {
+            err << "Error: " << e.what() << std::endl;
+            status = 1;
+            continue;
+        }
+        // Clients have no terminal to read from
+        std::istringstream noInput;
+        ready->setStreams(out, err, noInput);
+        int code = config.run(*ready, script.name, std::move(script.code));
+        if (code != 0) status = code;
+        // A used interpreter keeps the script's globals, so never reuse it
+        ready.reset();
+    }
+    out.flush();
+    err.flush();
+    writeFrame(fd, Frame::Exit, std::to_string(status));
+}
+
+void workerLoop(int listener, const Config& config) {
+    std::unique_ptr<JeveInterpreter> ready;
+    while (true) {
+        // Warm up before waiting, so the next client gets a ready interpreter
+        if (!ready) {
+            try {
+                ready = config.prepare();
+            } catch (const std::exception&) {
+                // Reported to the client that needs it
+            }
+        }
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+        handleClient(client, config, ready);
+        ::close(client);
+    }
+}
+
+// Lets the signal handler remove the socket file on shutdown
+char g_socketPath[sizeof(sockaddr_un::sun_path)];
+
+extern "C" void stopServer(int) {
+    ::unlink(g_socketPath);
+    ::_exit(0);
+}
+
+} // namespace
+
+std::string defaultSocketPath() {
+    if (const char* path = std::getenv("JEVE_SOCKET")) {
+        if (*path) return path;
+    }
+    // Only this user can create files in the runtime directory
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR")) {
+        if (*runtime) return std::string(runtime) + "/jeve.sock";
+    }
+    // Otherwise a directory of our own in /tmp, which nobody else may have
+    // made first or be able to enter
+    std::string directory = "/tmp/jeve-" + std::to_string(::getuid());
+    if (::mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        std::cerr << "Error: Could not create " << directory << ": " << std::strerror(errno) << std::endl;
+        return std::string();
+    }
+    struct stat info;
+    if (::lstat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != ::getuid() ||
+        (info.st_mode & 0077) != 0) {
+        std::cerr << "Error: " << directory << " is not a private directory of this user; use --socket" << std::endl;
+        return std::string();
+    }
+    return directory + "/jeve.sock";
+}
+
+int serve(const Config& config) {
+    sockaddr_un address;
+    if (!makeAddress(config.socketPath, address)) {
+        std::cerr << "Error: Invalid socket path: " << config.socketPath << std::endl;
+        return 1;
+    }
+    // A socket file nobody answers on is left over from a server that died
+    int existing = connectTo(config.socketPath);
+    if (existing >= 0) {
+        bool ours = peerIsOwner(existing);
+        ::close(existing);
+        if (ours) {
+            std::cerr << "Error: A server is already listening on " << config.socketPath << std::endl;
+        } else {
+            std::cerr << "Error: Another user is listening on " << config.socketPath << std::endl;
+        }
+        return 1;
+    }
+    ::unlink(config.socketPath.c_str());
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    // Only the owner may connect; the server runs any script it is sent
+    mode_t oldMask = ::umask(0077);
+    int bound = ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    ::umask(oldMask);
+    if (bound != 0 || ::listen(listener, 64) != 0) {
+        std::cerr << "Error: Could not listen on " << config.socketPath << ": " << std::strerror(errno) << std::endl;
+        ::close(listener);
+        return 1;
+    }
+
+    std::memcpy(g_socketPath, config.socketPath.c_str(), config.socketPath.size() + 1);
+    std::signal(SIGINT, stopServer);
+    std::signal(SIGTERM, stopServer);
+    // A client that disconnects early must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    size_t workers = config.workers;
+    if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Serving on " << config.socketPath << " with " << workers << " workers" << std::endl;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; ++i) {
+        threads.emplace_back(workerLoop, listener, std::cref(config));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ::close(listener);
+    ::unlink(config.socketPath.c_str());
+    return 1;
+}
+
+int runClient(const std::string& socketPath, const std::vector<std::string>& files) {
+    std::vector<std::pair<Frame, std::string>> request;
+    for (const std::string& file : files) {
+        if (file == "-") {
+            request.emplace_back(Frame::Source, std::string(std::istreambuf_iterator<char>(std::cin),
+                                                            std::istreambuf_iterator<char>()));
+            continue;
+        }
+        // The server resolves paths from its own directory
+        char resolved[PATH_MAX];
+        if (!std::ifstream(file) || !::realpath(file.c_str(), resolved)) {
+            std::cerr << "Error: Could not open file: " << file << std::endl;
+            return 1;
+        }
+        request.emplace_back(Frame::File, resolved);
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    int fd = connectTo(socketPath);
+    if (fd < 0) {
+        std::cerr << "Error: Could not connect to a jeve server on " << socketPath << std::endl;
+        return 1;
+    }
+    // Never send script paths to, or trust output from, someone else's server
+    if (!peerIsOwner(fd)) {
+        ::close(fd);
+        std::cerr << "Error: The server on " << socketPath << " belongs to another user" << std::endl;
+        return 1;
+    }
+    bool sent = true;
+    for (const auto& frame : request) {
+        sent = sent && writeFrame(fd, frame.first, frame.second);
+    }
+    sent = sent && writeFrame(fd, Frame::Run, std::string());
+
+    Frame type;
+    std::string payload;
+    while (sent && readFrame(fd, type, payload)) {
+        switch (type) {
+            case Frame::Out:
+                std::cout.write(payload.data(), static_cast<std::streamsize>(payload.size())).flush();
+                break;
+            case Frame::Err:
+                std::cerr.write(payload.data(), static_cast<std::streamsize>(payload.size())).flush();
+                break;
+            case Frame::Exit:
+                ::close(fd);
+                return std::atoi(payload.c_str());
+            default:
+                break;
+        }
+    }
+    ::close(fd);
+    std::cerr << "Error: The jeve server closed the connection" << std::endl;
+    return 1;
+}
+
+#endif
+
+} // namespace server
+} // namespace jeve
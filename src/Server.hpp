@@ -0,0 +1,53 @@
+#pragma once
+
+#include "interpreter/JeveInterpreter.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace jeve {
+namespace server {
+
+// Local script server. Clients connect over a Unix domain socket and send
+// script paths or source; each end checks that the other runs as the same
+// user. The server runs each request in an interpreter prepared before the
+// request arrived and streams its output back.
+//
+// Every message in either direction is a frame: one type byte, a 32-bit
+// payload length in host byte order, then the payload. The socket is local,
+// so both ends always share a byte order.
+enum class Frame : char {
+    File = 'F',    // client: absolute path of a script to run
+    Source = 'S',  // client: script source text
+    Run = 'R',     // client: end of request
+    Out = 'O',     // server: standard output
+    Err = 'E',     // server: standard error
+    Exit = 'X'     // server: exit code as decimal text; last frame
+};
+
+struct Config {
+    std::string socketPath;
+    size_t workers = 0;  // 0 picks the number of hardware threads
+    // Builds the interpreter for the next request; each worker calls it
+    // while idle so a request never waits for heap or snapshot setup
+    std::function<std::unique_ptr<JeveInterpreter>()> prepare;
+    // Runs a script in a prepared interpreter and returns its exit code
+    std::function<int(JeveInterpreter&, const std::string& name, std::string code)> run;
+};
+
+// $JEVE_SOCKET, else jeve.sock in $XDG_RUNTIME_DIR, else in a private
+// /tmp/jeve-<uid> directory it creates. Reports why and returns an empty
+// string if that directory exists but is not private to this user.
+std::string defaultSocketPath();
+
+// Serves until SIGINT or SIGTERM and returns the process exit code
+int serve(const Config& config);
+
+// Sends the scripts ("-" reads source from stdin) to the server at
+// socketPath, copies their output to stdout and stderr, and returns the
+// exit code the server reported
+int runClient(const std::string& socketPath, const std::vector<std::string>& files);
+
+} // namespace server
+} // namespace jeve
@@ -4,6 +4,7 @@
 #include "SymbolTable.hpp"
 #include "Value.hpp"
 #include "Object.hpp"
+#include "ProgramCache.hpp"
 #include <string>
 #include <iostream>
 #include <regex>
@@ -19,6 +20,10 @@ class ASTNode : public Object {
 public:
     virtual ~ASTNode() = default;
     virtual Value evaluate(SymbolTable& scope) = 0;
+    // Appends this node and its children to a compiled-script stream
+    virtual void serialize(ProgramWriter& out) const = 0;
+    // Nodes live in their program's arena and hold no heap values
+    void trace(Visitor&) const override {}
 };
 
 } // namespace jeve 
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace jeve {
+
+// Bump allocator for objects that share one lifetime, such as the AST of a
+// program. Memory comes from large chunks that are released all at once when
+// the arena is destroyed; destructors run in reverse order of creation.
+class Arena {
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::vector<Destructor> destructors;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t bytesAllocated = 0;
+
+    static uintptr_t alignUp(uintptr_t address, size_t alignment) {
+        return (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    }
+
+public:
+    Arena() = default;
+
+    ~Arena() {
+        for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+            it->destroy(it->object);
+        }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment) {
+        uintptr_t aligned = alignUp(reinterpret_cast<uintptr_t>(cursor), alignment);
+        if (!cursor || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+            size_t chunkSize = std::max(CHUNK_SIZE, size + alignment);
+            chunks.emplace_back(new char[chunkSize]);
+            cursor = chunks.back().get();
+            limit = cursor + chunkSize;
+            aligned = alignUp(reinterpret_cast<uintptr_t>(cursor), alignment);
+        }
+        cursor = reinterpret_cast<char*>(aligned + size);
+        bytesAllocated += size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        // Reserve first so registering the destructor cannot throw after construction
+        if (!std::is_trivially_destructible<T>::value && destructors.size() == destructors.capacity()) {
+            destructors.reserve(std::max<size_t>(64, destructors.capacity() * 2));
+        }
+        T* obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            destructors.push_back({[](void* p) { static_cast<T*>(p)->~T(); }, obj});
+        }
+        return obj;
+    }
+
+    size_t getBytesAllocated() const { return bytesAllocated; }
+    size_t getChunkCount() const { return chunks.size(); }
+};
+
+} // namespace jeve
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JEVE_SCAN_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JEVE_SCAN_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace jeve {
+namespace scan {
+
+// Character classes used by the lexer, one lookup per byte
+enum CharClass : uint8_t {
+    CHAR_SPACE = 1 << 0,
+    CHAR_DIGIT = 1 << 1,
+    CHAR_IDENT_START = 1 << 2,
+    CHAR_IDENT = 1 << 3
+};
+
+constexpr std::array<uint8_t, 256> makeCharClasses() {
+    std::array<uint8_t, 256> classes{};
+    classes[' '] = classes['\t'] = classes['\n'] = classes['\v'] = classes['\f'] = classes['\r'] = CHAR_SPACE;
+    for (int c = '0'; c <= '9'; ++c) classes[c] = CHAR_DIGIT | CHAR_IDENT;
+    for (int c = 'a'; c <= 'z'; ++c) classes[c] = CHAR_IDENT_START | CHAR_IDENT;
+    for (int c = 'A'; c <= 'Z'; ++c) classes[c] = CHAR_IDENT_START | CHAR_IDENT;
+    classes['_'] = CHAR_IDENT_START | CHAR_IDENT;
+    return classes;
+}
+
+constexpr std::array<uint8_t, 256> CHAR_CLASSES = makeCharClasses();
+
+inline bool is(char c, uint8_t charClass) {
+    return (CHAR_CLASSES[static_cast<unsigned char>(c)] & charClass) != 0;
+}
+
+inline unsigned firstSetBit(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+#if JEVE_SCAN_SSE2
+// Bytes of x that are <= limit when both are read as unsigned
+inline __m128i lessEqualUnsigned(__m128i x, __m128i limit) {
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, limit), x);
+}
+
+inline uint32_t spaceMask(__m128i chunk) {
+    // ' ' or '\t' through '\r'
+    __m128i controls = lessEqualUnsigned(_mm_sub_epi8(chunk, _mm_set1_epi8('\t')), _mm_set1_epi8('\r' - '\t'));
+    __m128i spaces = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(controls, spaces)));
+}
+
+inline uint32_t identMask(__m128i chunk) {
+    __m128i letters = lessEqualUnsigned(_mm_sub_epi8(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), _mm_set1_epi8('a')),
+                                        _mm_set1_epi8('z' - 'a'));
+    __m128i digits = lessEqualUnsigned(_mm_sub_epi8(chunk, _mm_set1_epi8('0')), _mm_set1_epi8('9' - '0'));
+    __m128i underscores = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, digits), underscores)));
+}
+#endif
+
+// Position of the first occurrence of byte in [pos, end), or end
+inline size_t findByte(const char* data, size_t pos, size_t end, char byte) {
+#if JEVE_SCAN_AVX2
+    const __m256i needle256 = _mm256_set1_epi8(byte);
+    while (pos + 32 <= end) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle256)));
+        if (mask) return pos + firstSetBit(mask);
+        pos += 32;
+    }
+#endif
+#if JEVE_SCAN_SSE2
+    const __m128i needle = _mm_set1_epi8(byte);
+    while (pos + 16 <= end) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        if (mask) return pos + firstSetBit(mask);
+        pos += 16;
+    }
+#endif
+    while (pos < end && data[pos] != byte) pos++;
+    return pos;
+}
+
+// Position of the first non-whitespace byte in [pos, end), or end
+inline size_t skipSpaces(const char* data, size_t pos, size_t end) {
+    // Most runs are a single space, so look at one byte before going wide
+    if (pos < end && !is(data[pos], CHAR_SPACE)) return pos;
+#if JEVE_SCAN_SSE2
+    while (pos + 16 <= end) {
+        uint32_t mask = ~spaceMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos))) & 0xFFFF;
+        if (mask) return pos + firstSetBit(mask);
+        pos += 16;
+    }
+#endif
+    while (pos < end && is(data[pos], CHAR_SPACE)) pos++;
+    return pos;
+}
+
+// Position of the first byte in [pos, end) that cannot continue an identifier
+inline size_t skipIdentifier(const char* data, size_t pos, size_t end) {
+#if JEVE_SCAN_SSE2
+    while (pos + 16 <= end) {
+        uint32_t mask = ~identMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos))) & 0xFFFF;
+        if (mask) return pos + firstSetBit(mask);
+        pos += 16;
+    }
+#endif
+    while (pos < end && is(data[pos], CHAR_IDENT)) pos++;
+    return pos;
+}
+
+} // namespace scan
+} // namespace jeve
@@ -13,11 +13,11 @@ class IdentifierNode;
 class BinaryOpNode;
 class UnaryOpNode;
 class PrintNode;
-class StatementNode;
 class BlockNode;
 class IfNode;
 class WhileNode;
 class ForNode;
+class ParallelForNode;
 class ArrayNode;
 class ArrayAccessNode;
 class ArrayAssignmentNode;
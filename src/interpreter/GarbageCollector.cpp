@@ -1,9 +1,7 @@
 #include "Object.hpp"
 #include "ObjectPool.hpp"
-#include "ASTNode.hpp"
-#include "ast/OperatorNodes.hpp"
-#include "ast/IONodes.hpp"
-#include "ast/ControlFlowNodes.hpp"
+#include "JeveInterpreter.hpp"
+#include "SymbolTable.hpp"
 #include <algorithm>
 #include <iostream>
 #include <chrono>
@@ -11,88 +9,898 @@
 
 namespace jeve {
 
-// Define the global GC pointer
-GarbageCollector* g_jeve_gc = nullptr;
+namespace {
+
+thread_local AllocationBuffer* currentBuffer = nullptr;
+thread_local GarbageCollector* currentCollector = nullptr;
+
+} // namespace
+
+AllocationBuffer* AllocationBuffer::current() {
+    return currentBuffer;
+}
+
+AllocationBuffer::Use::Use(AllocationBuffer& buffer) : previous(currentBuffer) {
+    currentBuffer = &buffer;
+}
+
+AllocationBuffer::Use::~Use() {
+    currentBuffer = previous;
+}
+
+std::atomic<int> Safepoint::requests{0};
+
+void Safepoint::reach() {
+    if (currentCollector) currentCollector->safepoint();
+}
+
+Safepoint::Use::Use(GarbageCollector& collector) : previous(currentCollector) {
+    currentCollector = &collector;
+}
+
+Safepoint::Use::~Use() {
+    currentCollector = previous;
+}
+
+GarbageCollector::~GarbageCollector() {
+    try {
+        collect();
+    } catch (...) {
+        std::cerr << "Error during final garbage collection" << std::endl;
+    }
+    if (markerThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(markerMutex);
+            markerShutdown = true;
+            markerStop = true;
+            if (safepointRaised.exchange(false)) Safepoint::withdraw();
+        }
+        markerWake.notify_one();
+        markerThread.join();
+    }
+}
+
+void ObjectPool::release(Object* obj) {
+    if (AllocationBuffer* buffer = AllocationBuffer::current()) {
+        buffer->release(obj);
+    } else if (collector) {
+        collector->reclaim(obj);
+    }
+}
+
+void ObjectPool::suspect(Object* obj) {
+    // Cycles dropped inside a parallel loop wait for a full collection
+    if (collector && !AllocationBuffer::current()) {
+        collector->addCandidate(obj);
+    }
+}
+
+void ObjectPool::shade(Object* obj) {
+    // Workers of a parallel loop must not touch the mark stack; what they
+    // reference is found when their objects are adopted, or kept by the
+    // check before condemned objects are freed
+    if (collector && !AllocationBuffer::current()) {
+        collector->mark(obj);
+    }
+}
+
+void GarbageCollector::adopt(const std::vector<AllocationBuffer>& buffers) {
+    // One worker may release an object another created, so every object is
+    // registered before any is freed
+    size_t created = 0;
+    for (const AllocationBuffer& buffer : buffers) {
+        for (Object* obj : buffer.getObjects()) {
+            nursery.push_back(obj);
+            objectPool.adopt(obj);
+            // Gray, so that marking finds what the workers stored in it
+            if (phase == Phase::Marking) mark(obj);
+        }
+        created += buffer.size();
+    }
+    for (const AllocationBuffer& buffer : buffers) {
+        for (Object* obj : buffer.getReleased()) {
+            if (obj->getRefCount() == 0) queue(obj);
+        }
+    }
+    drainPending();
+    if (created > 0) {
+        logger->logMemoryUsage(getObjectCount(), getHeapUsage(), initialHeap, maxHeap);
+    }
+}
+
+void GarbageCollector::reclaim(Object* obj) {
+    queue(obj);
+    // A collection frees what it queued once its lists are consistent again
+    if (!isCollecting) drainPending(incremental ? sliceBudget : Clock::duration::max());
+}
+
+void GarbageCollector::addCandidate(Object* obj) {
+    // Trial deletion may trace a large graph in one pause; incremental
+    // cycles find garbage cycles instead
+    if (incremental) return;
+    obj->candidateSlot = static_cast<uint32_t>(candidates.size());
+    candidates.push_back(obj);
+}
+
+void GarbageCollector::queue(Object* obj) {
+    if (obj->gcFlags & PENDING) return;
+    obj->gcFlags |= PENDING;
+    pending.push_back(obj);
+}
+
+ObjectList& GarbageCollector::listOf(const Object* obj) {
+    if (obj->gcFlags & CONDEMNED) return condemned;
+    return obj->gcFlags & TENURED ? tenured : nursery;
+}
+
+void GarbageCollector::destroy(Object* obj) {
+    if (obj == sweepCursor) advanceSweep(obj);
+    if (obj == tenuredStart) tenuredStart = ObjectList::older(obj);
+    listOf(obj).remove(obj);
+    if (obj->candidateSlot != Object::NO_SLOT) {
+        candidates[obj->candidateSlot] = nullptr;
+    }
+    objectPool.unregister(obj);
+    objectPool.destroy(obj);
+}
+
+void GarbageCollector::drainPending(Clock::duration budget) {
+    // Deleting a container releases its elements, which queue themselves
+    // here instead of being deleted inside its destructor, so long chains
+    // are freed without deep recursion
+    if (draining) return;
+    draining = true;
+    // Small batches never read the clock
+    bool timed = budget != Clock::duration::max();
+    Clock::time_point deadline;
+    size_t freed = 0;
+    while (!pending.empty()) {
+        if (timed && (++freed & 63) == 0) {
+            Clock::time_point now = Clock::now();
+            if (freed == 64) {
+                deadline = now + budget;
+            } else if (now >= deadline) {
+                break;
+            }
+        }
+        Object* obj = pending.back();
+        pending.pop_back();
+        obj->gcFlags &= ~PENDING;
+        // An object waiting to be marked is freed when marking reaches it
+        if (obj->getRefCount() == 0 && !(obj->gcFlags & ON_STACK)) {
+            if (objectPool.isMarkingConcurrently() && obj->isMarked()) {
+                deferred.push_back(obj);
+            } else {
+                destroy(obj);
+            }
+        }
+    }
+    draining = false;
+}
+
+namespace {
+
+// Takes the references other traced objects hold out of each count
+class InternalReferences : public Visitor {
+public:
+    void visit(Object* obj) override {
+        if (obj && obj->getGCRefs() > 0) {
+            obj->setGCRefs(obj->getGCRefs() - 1);
+        }
+    }
+};
+
+// Marks the traced objects an object refers to
+class Marker : public Visitor {
+private:
+    GarbageCollector& gc;
+
+public:
+    explicit Marker(GarbageCollector& collector) : gc(collector) {}
+
+    void visit(Object* obj) override {
+        if (obj && obj->getGCRefs() != Object::UNTRACED) {
+            gc.mark(obj);
+        }
+    }
+};
+
+// Applies f to each heap object another object refers to. Objects without a
+// pool live in a program arena and are never freed by the collector.
+template<typename F>
+class EachChild : public Visitor {
+private:
+    F f;
+
+public:
+    explicit EachChild(F function) : f(function) {}
+
+    void visit(Object* obj) override {
+        if (obj && obj->getPool()) f(obj);
+    }
+};
+
+template<typename F>
+void forEachChild(const Object* obj, F f) {
+    EachChild<F> visitor(f);
+    obj->trace(visitor);
+}
+
+// Marks every heap object an object refers to; used by incremental marking,
+// which traces from the globals instead of from counted roots
+class Shader : public Visitor {
+private:
+    GarbageCollector& gc;
+
+public:
+    explicit Shader(GarbageCollector& collector) : gc(collector) {}
+
+    void visit(Object* obj) override {
+        if (obj && obj->getPool()) gc.mark(obj);
+    }
+};
+
+// Marks for a mark thread of a parallel collection. Children are gathered
+// first, so the rest of a large container can be pushed beneath them.
+class ParallelMarker : public Visitor {
+private:
+    std::vector<Object*>& found;
+
+public:
+    explicit ParallelMarker(std::vector<Object*>& list) : found(list) {}
+
+    void visit(Object* obj) override {
+        if (obj && obj->getGCRefs() != Object::UNTRACED && obj->tryMark()) {
+            found.push_back(obj);
+        }
+    }
+};
+
+// Marks for the concurrent marker, whose work list only it uses
+class ConcurrentShader : public Visitor {
+private:
+    std::vector<std::pair<Object*, size_t>>& work;
+
+public:
+    explicit ConcurrentShader(std::vector<std::pair<Object*, size_t>>& list) : work(list) {}
+
+    void visit(Object* obj) override {
+        if (obj && obj->getPool() && obj->tryMark()) work.emplace_back(obj, 0);
+    }
+};
+
+template<typename F>
+void forEachObject(ObjectList* const* generations, size_t count, F f) {
+    for (size_t i = 0; i < count; ++i) {
+        // Newest first; f may unlink the object it is given
+        Object* obj = generations[i]->newest();
+        while (obj) {
+            Object* older = ObjectList::older(obj);
+            f(*generations[i], obj);
+            obj = older;
+        }
+    }
+}
+
+} // namespace
 
 void GarbageCollector::mark(Object* obj) {
-    if (!obj || obj->isMarked()) {
+    // The concurrent marker may be marking the same object
+    if (!obj || !obj->tryMark()) {
         return;
     }
     
-    obj->mark();
-    
     // We'll use a non-recursive approach to avoid stack overflow
-    if (auto* node = dynamic_cast<ASTNode*>(obj)) {
-        // Add to mark stack for later processing
-        markStack.push(obj);
+    obj->gcFlags |= ON_STACK;
+    markStack.push(obj);
+}
+
+void GarbageCollector::processMarkStack(size_t traced) {
+    if (markThreads != 1 && traced >= PARALLEL_MARK_MIN && !markStack.empty()) {
+        if (!markPool) markPool = std::make_unique<ThreadPool>(markThreads);
+        if (markPool->size() > 1) {
+            markInParallel();
+            return;
+        }
+    }
+    Marker marker(*this);
+    while (!markStack.empty()) {
+        Object* obj = markStack.top();
+        markStack.pop();
+        obj->gcFlags &= ~ON_STACK;
+        obj->trace(marker);
     }
 }
 
-void GarbageCollector::processMarkStack() {
-            while (!markStack.empty()) {
+void GarbageCollector::markInParallel() {
+    size_t workers = markPool->size();
+    while (markDeques.size() < workers) {
+        markDeques.push_back(std::make_unique<MarkDeque>());
+    }
+    // Deal the roots out; nothing is freed until marking is over, so they
+    // need no ON_STACK flag
+    std::atomic<size_t> outstanding{markStack.size()};
+    for (size_t i = 0; !markStack.empty(); ++i) {
         Object* obj = markStack.top();
         markStack.pop();
-        
-        // Process based on object type
-        if (auto* binaryOp = dynamic_cast<BinaryOpNode*>(obj)) {
-            if (auto* left = binaryOp->getLeft()) {
-                mark(left);
-            }
-            if (auto* right = binaryOp->getRight()) {
-                mark(right);
-            }
+        obj->gcFlags &= ~ON_STACK;
+        markDeques[i % workers]->push({obj, 0});
+    }
+    markPool->parallelFor(workers, [&](size_t worker) {
+        markWorker(worker, outstanding);
+    });
+    for (auto& deque : markDeques) deque->reset();
+}
+
+void GarbageCollector::markWorker(size_t worker, std::atomic<size_t>& outstanding) {
+    // outstanding counts the tasks pushed and not yet traced. Pushes are
+    // added before the tasks can be stolen, and traced tasks subtracted in
+    // batches, so it never drops to zero while there is work left.
+    MarkDeque& own = *markDeques[worker];
+    size_t workers = markPool->size();
+    std::vector<Object*> found;
+    ParallelMarker marker(found);
+    size_t traced = 0;
+    MarkTask task;
+    while (true) {
+        bool got = own.take(task);
+        for (size_t i = 1; !got && i < workers; ++i) {
+            got = markDeques[(worker + i) % workers]->steal(task);
         }
-        else if (auto* printNode = dynamic_cast<PrintNode*>(obj)) {
-            if (auto* expr = printNode->getExpression()) {
-                mark(expr);
+        if (!got) {
+            if (traced > 0) {
+                outstanding.fetch_sub(traced);
+                traced = 0;
             }
+            if (outstanding.load() == 0) return;
+            std::this_thread::yield();
+            continue;
         }
-        else if (auto* statementNode = dynamic_cast<StatementNode*>(obj)) {
-            if (auto* stmt = statementNode->getStatement()) {
-                mark(stmt);
-            }
-            if (auto* next = statementNode->getNext()) {
-                mark(next);
-            }
+        found.clear();
+        size_t next = task.obj->tracePart(marker, task.offset, TRACE_CHUNK);
+        size_t pushed = found.size() + (next ? 1 : 0);
+        if (pushed > 0) outstanding.fetch_add(pushed);
+        // The rest of a large container goes beneath its children, nearer
+        // the end thieves take from, so a huge array is traced by many threads
+        if (next) own.push({task.obj, next});
+        for (Object* child : found) own.push({child, 0});
+        if (++traced == 64) {
+            outstanding.fetch_sub(traced);
+            traced = 0;
+        }
+    }
+}
+
+void GarbageCollector::recordPause(Clock::time_point start) {
+    lastPauseEnd = Clock::now();
+    pauses.push_back(std::chrono::duration<double, std::micro>(lastPauseEnd - start).count());
+}
+
+void GarbageCollector::printPauses(std::ostream& out) const {
+    double total = 0.0;
+    double longest = 0.0;
+    for (double pause : pauses) {
+        total += pause;
+        longest = std::max(longest, pause);
+    }
+    double p99 = 0.0;
+    if (!pauses.empty()) {
+        std::vector<double> sorted(pauses);
+        size_t rank = (sorted.size() * 99 + 99) / 100 - 1;
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        p99 = sorted[rank];
+    }
+    out << "[GC] Pauses: " << pauses.size() << ", total " << total / 1000.0 << " ms, max "
+        << longest / 1000.0 << " ms, p99 " << p99 / 1000.0 << " ms" << std::endl;
+}
+
+size_t GarbageCollector::collectGarbage(bool wholeHeap) {
+    ObjectList* generations[] = {&nursery, &tenured};
+    size_t count = wholeHeap ? 2 : 1;
+    size_t freed = 0;
+
+    // The roots are the objects referenced from outside the traced
+    // generations: from the global scope or a function's scope, from a
+    // temporary held by native code, or, in a minor collection, from a
+    // tenured object. Each such reference is counted, but no traced object
+    // accounts for it.
+    forEachObject(generations, count, [](ObjectList&, Object* obj) {
+        obj->setGCRefs(obj->getRefCount());
+    });
+    InternalReferences internal;
+    forEachObject(generations, count, [&](ObjectList&, Object* obj) {
+        obj->trace(internal);
+    });
+    forEachObject(generations, count, [&](ObjectList&, Object* obj) {
+        if (obj->getGCRefs() > 0) {
+            mark(obj);
+        }
+    });
+    processMarkStack(wholeHeap ? nursery.size() + tenured.size() : nursery.size());
+
+    // What is left unmarked is garbage, cycles included. Its objects drop
+    // their references first, so deleting one never leaves another pointing
+    // at freed memory. The caller frees them once the nursery is promoted.
+    forEachObject(generations, count, [](ObjectList&, Object* obj) {
+        if (!obj->isMarked()) {
+            obj->releaseReferences();
         }
+    });
+    forEachObject(generations, count, [&](ObjectList&, Object* obj) {
+        obj->setGCRefs(Object::UNTRACED);
+        obj->gcFlags |= TENURED;
+        if (obj->isMarked()) {
+            obj->unmark();
+        } else if (obj->getRefCount() == 0) {
+            queue(obj);
+            ++freed;
+        }
+    });
+    return freed;
+}
+
+void GarbageCollector::collectYoung() {
+    // Workers of a parallel loop share the heap; it is collected afterwards.
+    // An incremental cycle owns the mark bits of the nursery until it has
+    // swept it; after that, the nursery only holds objects allocated since.
+    if (isCollecting || AllocationBuffer::current()) return;
+    if (phase == Phase::Marking || (phase == Phase::Sweeping && !sweepingTenured)) return;
+    Clock::time_point start = Clock::now();
+    isCollecting = true;
+
+    size_t freed = collectGarbage(false);
+    if (debug) {
+        *log << "[GC] Minor collection freed " << freed << " objects, promoted " << nursery.size() << std::endl;
     }
+    tenured.splice(nursery);
+    ++minorCollections;
+
+    isCollecting = false;
+    drainPending();
+    objectPool.trimHeap();
+    recordPause(start);
 }
 
 void GarbageCollector::collect() {
-    if (isCollecting) return;
+    // Workers of a parallel loop share the heap; it is collected afterwards
+    if (isCollecting || AllocationBuffer::current()) return;
+    finishCycle();
+    Clock::time_point start = Clock::now();
     isCollecting = true;
-    
-    // Mark phase - only mark objects that are currently in use
-    for (auto* obj : objects) {
-        if (obj->getRefCount() > 0) {
-                mark(obj);
-            }
+
+    size_t freed = collectGarbage(true);
+    tenured.splice(nursery);
+    ++majorCollections;
+    if (debug) {
+        *log << "[GC] Major collection freed " << freed << " objects, " << tenured.size() << " remain" << std::endl;
+    }
+    // Every cycle has just been found, so the buffered roots need no scan
+    for (Object* obj : candidates) {
+        if (obj) obj->candidateSlot = Object::NO_SLOT;
+    }
+    candidates.clear();
+
+    isCollecting = false;
+    drainPending();
+    objectPool.trimHeap();
+    recordPause(start);
+
+    // Log memory usage after collection
+    logger->logMemoryUsage(getObjectCount(), getHeapUsage(), initialHeap, maxHeap);
+}
+
+void GarbageCollector::collectCycles() {
+    if (isCollecting || AllocationBuffer::current()) return;
+    Clock::time_point start = Clock::now();
+    isCollecting = true;
+
+    std::vector<Object*> roots;
+    roots.swap(candidates);
+    std::vector<Object*> visited;
+    std::vector<Object*> stack;
+
+    // Mark gray: subtract the references from inside the graph below the
+    // roots. gcRefs holds each object's trial count.
+    auto gray = [&](Object* obj) {
+        if (obj->gcFlags & GRAY) return;
+        obj->gcFlags |= GRAY;
+        obj->setGCRefs(obj->getRefCount());
+        visited.push_back(obj);
+        stack.push_back(obj);
+    };
+    for (Object*& root : roots) {
+        if (!root) continue;
+        root->candidateSlot = Object::NO_SLOT;
+        // Objects with no references left are freed anyway
+        if (root->getRefCount() == 0 || (root->gcFlags & PENDING)) {
+            root = nullptr;
+            continue;
         }
-        
-    // Process mark stack to mark all reachable objects
-        processMarkStack();
-        
-    // Sweep phase: remove unmarked objects
-    auto it = objects.begin();
-    while (it != objects.end()) {
-        if (!(*it)->isMarked()) {
-            // Object is not reachable, remove it
-            Object* obj = *it;
-            it = objects.erase(it);
-            if (obj->getPool()) {
-                obj->getPool()->release(obj);
-            }
-            delete obj;
+        gray(root);
+        while (!stack.empty()) {
+            Object* obj = stack.back();
+            stack.pop_back();
+            forEachChild(obj, [&](Object* child) {
+                gray(child);
+                child->setGCRefs(child->getGCRefs() - 1);
+            });
+        }
+    }
+
+    // Scan: an object still referenced from outside keeps everything it
+    // reaches; the rest is white
+    auto scanBlack = [&](Object* obj) {
+        std::vector<Object*> black{obj};
+        obj->gcFlags &= ~WHITE;
+        obj->setGCRefs(Object::UNTRACED);
+        while (!black.empty()) {
+            Object* next = black.back();
+            black.pop_back();
+            forEachChild(next, [&](Object* child) {
+                if (child->getGCRefs() != Object::UNTRACED) {
+                    child->gcFlags &= ~WHITE;
+                    child->setGCRefs(Object::UNTRACED);
+                    black.push_back(child);
+                }
+            });
+        }
+    };
+    for (Object* root : roots) {
+        if (!root) continue;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            Object* obj = stack.back();
+            stack.pop_back();
+            // Gray and not yet scanned
+            if (obj->getGCRefs() == Object::UNTRACED || (obj->gcFlags & WHITE)) continue;
+            if (obj->getGCRefs() > 0) {
+                scanBlack(obj);
             } else {
-            (*it)->unmark();
-                ++it;
+                obj->gcFlags |= WHITE;
+                forEachChild(obj, [&](Object* child) { stack.push_back(child); });
             }
+        }
     }
-    
+
+    // Collect white: the cycles drop their references to each other and to
+    // the rest of the heap, which leaves their counts at zero
+    std::vector<Object*> garbage;
+    for (Object* obj : visited) {
+        if (obj->gcFlags & WHITE) garbage.push_back(obj);
+        obj->gcFlags &= ~(GRAY | WHITE);
+        obj->setGCRefs(Object::UNTRACED);
+    }
+    for (Object* obj : garbage) {
+        obj->releaseReferences();
+    }
+    for (Object* obj : garbage) {
+        if (obj->getRefCount() == 0) queue(obj);
+    }
+    ++cycleCollections;
+    candidateLimit = std::max(nurseryLimit, visited.size());
+    if (debug) {
+        *log << "[GC] Cycle collection scanned " << visited.size() << " objects, freed "
+                  << garbage.size() << std::endl;
+    }
+
     isCollecting = false;
-    
-    // Log memory usage after collection
-    logger->logMemoryUsage(getObjectCount(), getHeapUsage(), initialHeap, maxHeap);
+    drainPending();
+    objectPool.trimHeap();
+    recordPause(start);
+}
+
+void GarbageCollector::requestCollection() {
+    if (!incremental) {
+        collect();
+    } else if (phase == Phase::Idle) {
+        startCycle();
+    }
+}
+
+void GarbageCollector::startCycle() {
+    if (phase != Phase::Idle || isCollecting || AllocationBuffer::current()) return;
+    Clock::time_point start = Clock::now();
+    phase = Phase::Marking;
+    objectPool.setMarking(true);
+    cycleSlices = 0;
+    // Locals and temporaries are not scanned: the check in
+    // reclaimCondemned() keeps whatever they still reference
+    Shader shader(*this);
+    if (interpreter) {
+        for (const auto& entry : interpreter->getGlobalScope()->getSymbols()) {
+            entry.second.trace(shader);
+        }
+    }
+    if (concurrent) {
+        objectPool.setMarkingConcurrently(true);
+        serviceMarker();
+    }
+    if (debug) {
+        *log << "[GC] " << (concurrent ? "Concurrent" : "Incremental") << " cycle started with "
+                  << getObjectCount() << " objects" << std::endl;
+    }
+    recordPause(start);
+}
+
+bool GarbageCollector::markSlice(Clock::time_point deadline) {
+    Shader shader(*this);
+    size_t work = 0;
+    while (partial || !markStack.empty()) {
+        if (work >= 64) {
+            if (Clock::now() >= deadline) return false;
+            work = 0;
+        }
+        // Large containers are traced a chunk at a time and stay on the
+        // stack meanwhile. Elements moved behind the chunk already traced
+        // are kept by the check in reclaimCondemned().
+        Object* obj = partial;
+        size_t begin = partialOffset;
+        partial = nullptr;
+        if (!obj) {
+            obj = markStack.top();
+            markStack.pop();
+            begin = 0;
+        }
+        // Dropped after it was shaded; free it now instead of tracing it
+        if (obj->getRefCount() == 0) {
+            obj->gcFlags &= ~ON_STACK;
+            queue(obj);
+            continue;
+        }
+        size_t next = obj->tracePart(shader, begin, TRACE_CHUNK);
+        if (next) {
+            partial = obj;
+            partialOffset = next;
+            work += 64;
+        } else {
+            obj->gcFlags &= ~ON_STACK;
+            ++work;
+        }
+    }
+    return true;
+}
+
+void GarbageCollector::beginSweep() {
+    phase = Phase::Sweeping;
+    objectPool.setMarking(false);
+    if (objectPool.isMarkingConcurrently()) {
+        objectPool.setMarkingConcurrently(false);
+        // The marker is done with them
+        for (Object* obj : deferred) queue(obj);
+        deferred.clear();
+    }
+    // Objects allocated from here on are unmarked and newer than the cursor.
+    // Nursery survivors are promoted as they are swept and go after
+    // tenuredStart, so the tenured part of the sweep does not see them.
+    tenuredStart = tenured.newest();
+    sweepingTenured = false;
+    sweepCursor = nursery.newest();
+    if (!sweepCursor) {
+        sweepingTenured = true;
+        sweepCursor = tenuredStart;
+    }
+}
+
+void GarbageCollector::advanceSweep(const Object* from) {
+    sweepCursor = ObjectList::older(from);
+    if (!sweepCursor && !sweepingTenured) {
+        sweepingTenured = true;
+        sweepCursor = tenuredStart;
+    }
+}
+
+bool GarbageCollector::sweepSlice(Clock::time_point deadline) {
+    size_t swept = 0;
+    while (sweepCursor) {
+        if ((++swept & 255) == 0 && Clock::now() >= deadline) return false;
+        Object* obj = sweepCursor;
+        advanceSweep(obj);
+        if (obj->isMarked()) {
+            obj->unmark();
+            if (!(obj->gcFlags & TENURED)) {
+                nursery.remove(obj);
+                obj->gcFlags |= TENURED;
+                tenured.push_back(obj);
+            }
+        } else {
+            listOf(obj).remove(obj);
+            obj->gcFlags |= CONDEMNED;
+            condemned.push_back(obj);
+        }
+    }
+    return true;
+}
+
+size_t GarbageCollector::reclaimCondemned() {
+    ObjectList* lists[] = {&condemned};
+    size_t freed = 0;
+
+    // Same check as collectGarbage(), over the condemned objects only:
+    // references from outside them were made by objects marking kept, by
+    // locals or by native code
+    forEachObject(lists, 1, [](ObjectList&, Object* obj) {
+        obj->setGCRefs(obj->getRefCount());
+    });
+    InternalReferences internal;
+    forEachObject(lists, 1, [&](ObjectList&, Object* obj) {
+        obj->trace(internal);
+    });
+    forEachObject(lists, 1, [&](ObjectList&, Object* obj) {
+        if (obj->getGCRefs() > 0) {
+            mark(obj);
+        }
+    });
+    processMarkStack(condemned.size());
+
+    forEachObject(lists, 1, [](ObjectList&, Object* obj) {
+        if (!obj->isMarked()) {
+            obj->releaseReferences();
+        }
+    });
+    forEachObject(lists, 1, [&](ObjectList&, Object* obj) {
+        obj->setGCRefs(Object::UNTRACED);
+        if (obj->isMarked()) {
+            obj->unmark();
+        } else if (obj->getRefCount() == 0) {
+            queue(obj);
+            ++freed;
+        }
+    });
+    // Survivors and garbage alike go to the tenured generation; the garbage
+    // is freed from there once this collection is done
+    forEachObject(lists, 1, [](ObjectList&, Object* obj) {
+        obj->gcFlags = static_cast<uint8_t>((obj->gcFlags & ~CONDEMNED) | TENURED);
+    });
+    tenured.splice(condemned);
+
+    phase = Phase::Idle;
+    sweepCursor = nullptr;
+    tenuredStart = nullptr;
+    ++majorCollections;
+    return freed;
+}
+
+void GarbageCollector::runSlice() {
+    if (isCollecting || AllocationBuffer::current()) return;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + sliceBudget;
+    size_t freed = 0;
+    bool done = false;
+    if (phase != Phase::Idle) {
+        isCollecting = true;
+        ++cycleSlices;
+        if (phase == Phase::Marking && (concurrent ? serviceMarker() : markSlice(deadline))) {
+            beginSweep();
+        }
+        done = phase == Phase::Sweeping && sweepSlice(deadline);
+        if (done) {
+            freed = reclaimCondemned();
+        }
+        isCollecting = false;
+    }
+
+    // Garbage is freed in slices too; what does not fit waits for the next
+    drainPending(std::max(deadline - Clock::now(), Clock::duration::zero()));
+    if (done) {
+        objectPool.trimHeap();
+        cycleTrigger = std::max(objectsIn(initialHeap), getObjectCount() * 2);
+        if (debug) {
+            *log << "[GC] " << (concurrent ? "Concurrent" : "Incremental") << " cycle freed " << freed << " objects in " << cycleSlices
+                      << " slices, " << getObjectCount() << " remain" << std::endl;
+        }
+        logger->logMemoryUsage(getObjectCount(), getHeapUsage(), initialHeap, maxHeap);
+    }
+    recordPause(start);
+}
+
+void GarbageCollector::finishCycle() {
+    if (phase == Phase::Idle || isCollecting) return;
+    Clock::time_point start = Clock::now();
+    isCollecting = true;
+
+    Clock::time_point never = Clock::time_point::max();
+    if (phase == Phase::Marking) {
+        if (concurrent) stopMarker();
+        markSlice(never);
+        beginSweep();
+    }
+    sweepSlice(never);
+    size_t freed = reclaimCondemned();
+
+    isCollecting = false;
+    drainPending();
+    objectPool.trimHeap();
+    cycleTrigger = std::max(objectsIn(initialHeap), getObjectCount() * 2);
+    if (debug) {
+        *log << "[GC] " << (concurrent ? "Concurrent" : "Incremental") << " cycle finished early, freed " << freed << " objects" << std::endl;
+    }
+    recordPause(start);
+}
+
+bool GarbageCollector::serviceMarker() {
+    std::lock_guard<std::mutex> lock(markerMutex);
+    if (safepointRaised.exchange(false)) Safepoint::withdraw();
+    if (!markStack.empty()) {
+        // Marked objects are not freed while the marker runs, so they need
+        // no ON_STACK flag once handed over
+        while (!markStack.empty()) {
+            Object* obj = markStack.top();
+            markStack.pop();
+            obj->gcFlags &= ~ON_STACK;
+            markerInbox.push_back(obj);
+        }
+        markerWake.notify_one();
+        return false;
+    }
+    // Nothing was shaded since the marker ran out of work: the remark is
+    // empty, since locals are left to the check in reclaimCondemned()
+    return markerIdle && markerInbox.empty();
+}
+
+void GarbageCollector::stopMarker() {
+    std::unique_lock<std::mutex> lock(markerMutex);
+    markerStop = true;
+    markerStopped.wait(lock, [this] { return markerIdle; });
+    markerStop = false;
+    if (safepointRaised.exchange(false)) Safepoint::withdraw();
+    // Already marked; traced again from the start by markSlice()
+    auto push = [this](Object* obj) {
+        obj->gcFlags |= ON_STACK;
+        markStack.push(obj);
+    };
+    for (const auto& entry : markerWork) push(entry.first);
+    for (Object* obj : markerInbox) push(obj);
+    markerWork.clear();
+    markerInbox.clear();
+}
+
+void GarbageCollector::markerLoop() {
+    std::unique_lock<std::mutex> lock(markerMutex);
+    while (true) {
+        markerIdle = true;
+        markerStopped.notify_all();
+        markerWake.wait(lock, [this] { return markerShutdown || (!markerInbox.empty() && !markerStop); });
+        if (markerShutdown) return;
+        for (Object* obj : markerInbox) markerWork.emplace_back(obj, 0);
+        markerInbox.clear();
+        markerIdle = false;
+        lock.unlock();
+        bool finished = traceConcurrently();
+        lock.lock();
+        // Out of work: the script ends marking at its next safepoint, or
+        // hands over what it shaded meanwhile
+        if (finished && markerInbox.empty() && !safepointRaised) {
+            safepointRaised = true;
+            Safepoint::request();
+        }
+    }
+}
+
+bool GarbageCollector::traceConcurrently() {
+    ConcurrentShader shader(markerWork);
+    // Containers the script held locked when the marker got to them
+    std::vector<std::pair<Object*, size_t>> busy;
+    while (!markerWork.empty() || !busy.empty()) {
+        if (markerStop.load(std::memory_order_relaxed)) {
+            markerWork.insert(markerWork.end(), busy.begin(), busy.end());
+            return false;
+        }
+        if (markerWork.empty()) {
+            std::this_thread::yield();
+            markerWork.swap(busy);
+        }
+        std::pair<Object*, size_t> entry = markerWork.back();
+        markerWork.pop_back();
+        size_t next = 0;
+        if (!entry.first->tryTracePart(shader, entry.second, TRACE_CHUNK, next)) {
+            busy.push_back(entry);
+        } else if (next) {
+            // Large containers are traced a chunk at a time, so the script
+            // never waits long for one
+            markerWork.emplace_back(entry.first, next);
+        }
+    }
+    return true;
 }
 
 bool GarbageCollector::shouldCollect() const {
@@ -101,15 +909,15 @@ bool GarbageCollector::shouldCollect() const {
     size_t usage = getHeapUsage();
     
     // Also collect if we have too many objects
-    return usage > threshold || objects.size() > 10000;
+    return usage > threshold || getObjectCount() > 10000;
 }
 
 void GarbageCollector::checkAndCollect() {
-    std::thread([this]() {
-        if (!isCollecting && shouldCollect()) {
-            collect();
-        }
-    }).detach();
+    // Runs on the interpreter's own thread: the heap is not safe to scan
+    // while the script is still mutating it
+    if (!isCollecting && shouldCollect()) {
+        collect();
+    }
 }
 
 } // namespace jeve 
\ No newline at end of file
@@ -2,21 +2,57 @@
 
 #include "Object.hpp"
 #include "ObjectPool.hpp"
+#include "MarkDeque.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
 #include <vector>
 #include <stack>
 #include <memory>
 #include <string>
 #include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+#include <ostream>
 #include <fstream>
 #include <iomanip>
 
-extern bool g_jeve_debug;
-
 namespace jeve {
 
 // Forward declarations
 class JeveInterpreter;
-extern GarbageCollector* g_jeve_gc;
+class GarbageCollector;
+
+// Points where a script may stop for its collector: loop back-edges and
+// function calls. A poll is one relaxed load of a counter that a concurrent
+// collector raises while it waits for its script; only then does the thread
+// look up the collector it runs for, which may not be the one waiting.
+class Safepoint {
+private:
+    static std::atomic<int> requests;
+
+public:
+    static void poll() {
+        if (requests.load(std::memory_order_relaxed) > 0) reach();
+    }
+    static void reach();
+    static void request() { requests.fetch_add(1); }
+    static void withdraw() { requests.fetch_sub(1); }
+
+    // Makes a collector the one the calling thread's safepoints serve
+    class Use {
+    private:
+        GarbageCollector* previous;
+
+    public:
+        explicit Use(GarbageCollector& collector);
+        ~Use();
+        Use(const Use&) = delete;
+        Use& operator=(const Use&) = delete;
+    };
+};
 
 class MemoryLogger {
 private:
@@ -26,7 +62,7 @@ private:
     size_t totalAllocations;
 
 public:
-    MemoryLogger(const std::string& filename = "memory_usage.csv", bool enabled = true) 
+    MemoryLogger(const std::string& filename = "memory_usage.csv", bool enabled = true)
         : isEnabled(enabled), processCount(0), totalAllocations(0) {
         if (enabled) {
             logFile.open(filename);
@@ -66,9 +102,48 @@ public:
     size_t getTotalAllocations() const { return totalAllocations; }
 };
 
+// Reference counting backed by a cycle collector and two generations. An
+// object is freed as soon as its last reference goes away. An object that
+// loses a reference but keeps others is buffered as a possible cycle root;
+// once the buffer fills, the graph below those roots is trial-deleted
+// (Bacon and Rajan) and the cycles it finds are freed, without touching the
+// rest of the heap.
+//
+// New objects go into the nursery; a minor collection traces only the
+// nursery once it outgrows its share of the initial heap, and promotes the
+// survivors to the tenured generation, which is only traced by a major
+// collection. Objects never move: native code holds plain pointers to them
+// through Ref and Value. An old container that stores a young value holds a
+// counted reference to it, so a minor collection keeps such objects without
+// a remembered set.
+//
+// In incremental mode a major collection runs in slices of bounded length
+// between allocations. Marking starts from the globals; every reference
+// made while it runs shades its object (a Dijkstra barrier in
+// Object::incrementRefCount), and objects allocated meanwhile are black.
+// Sweeping moves what is unmarked to a condemned list. Before anything on
+// it is freed, the counts of its objects are checked against the
+// references among them, and whatever is still referenced from elsewhere
+// (a local variable, a temporary held by native code) is kept with all it
+// reaches.
+//
+// The marking of a minor or major collection, and of the check above, is
+// split across the collector's mark threads once enough objects are
+// traced. Each thread owns a work-stealing deque of gray objects and takes
+// work from the others' when its own runs dry; mark bits are set
+// atomically, so an object is traced once whichever thread reaches it.
+//
+// In concurrent mode marking runs on a thread of the collector's own while
+// the script goes on. The script only stops to shade the globals, to hand
+// the marker what its barrier shaded, and once the marker runs dry, to end
+// marking; sweeping is incremental as above. While the marker runs, the
+// script takes a container's lock to change it, and an object that was
+// marked is not deleted even when its count drops to zero, since the marker
+// may be tracing it; such objects are freed once marking is over.
 class GarbageCollector {
 private:
-    std::vector<Object*> objects;
+    ObjectList nursery;
+    ObjectList tenured;
     std::stack<Object*> markStack;
     bool isCollecting;
     size_t initialHeap;
@@ -76,30 +151,223 @@ private:
     std::unique_ptr<MemoryLogger> logger;
     ObjectPool objectPool;
     JeveInterpreter* interpreter;
+    bool debug = false;
+    std::ostream* log = &std::cout;  // where debug traces go
+    size_t nurseryLimit;   // objects allocated between minor collections
+    size_t minorCollections = 0;
+    size_t majorCollections = 0;
+    size_t cycleCollections = 0;
+
+    // Possible cycle roots; entries of objects freed since are null
+    std::vector<Object*> candidates;
+    // Candidates that trigger the next cycle collection: at least as many as
+    // the last one scanned, so a large live graph below a root that keeps
+    // coming back is not scanned over and over
+    size_t candidateLimit;
+    // Objects to free once the current collection or free is done
+    std::vector<Object*> pending;
+    bool draining = false;
+
+    // Bits of Object::gcFlags
+    static constexpr uint8_t TENURED = 1;
+    static constexpr uint8_t PENDING = 2;
+    static constexpr uint8_t GRAY = 4;    // being trial-deleted
+    static constexpr uint8_t WHITE = 8;   // found to be garbage
+    static constexpr uint8_t ON_STACK = 16;
+    static constexpr uint8_t CONDEMNED = 32;
+
+    // Incremental major collection
+    enum class Phase { Idle, Marking, Sweeping };
+    using Clock = std::chrono::steady_clock;
+    bool incremental = false;
+    Clock::duration sliceBudget = std::chrono::microseconds(500);
+    Phase phase = Phase::Idle;
+    ObjectList condemned;
+    Object* partial = nullptr;       // container marking has traced in part
+    size_t partialOffset = 0;
+    Object* sweepCursor = nullptr;   // next object to sweep, newest first
+    Object* tenuredStart = nullptr;  // newest tenured object when sweeping began
+    bool sweepingTenured = false;
+    size_t cycleTrigger;             // objects at which the next cycle starts
+    size_t allocationsSinceCheck = 0;
+    size_t cycleSlices = 0;
+    Clock::time_point lastPauseEnd;
+
+    // Concurrent marking. The marker thread owns markerWork while it runs;
+    // the rest is guarded by markerMutex.
+    bool concurrent = false;
+    std::thread markerThread;
+    std::mutex markerMutex;
+    std::condition_variable markerWake;      // work, a stop or shutdown for the marker
+    std::condition_variable markerStopped;   // the marker went idle
+    std::vector<Object*> markerInbox;        // gray objects handed over by the script
+    std::vector<std::pair<Object*, size_t>> markerWork;  // objects and where to resume tracing them
+    bool markerIdle = true;
+    bool markerShutdown = false;
+    std::atomic<bool> markerStop{false};
+    std::atomic<bool> safepointRaised{false};
+    // Objects whose count dropped to zero while the marker might trace them
+    std::vector<Object*> deferred;
+
+    // Parallel marking; the pool is created by the first collection large
+    // enough to use it
+    size_t markThreads = 1;
+    std::unique_ptr<ThreadPool> markPool;
+    std::vector<std::unique_ptr<MarkDeque>> markDeques;
+
+    // Every pause, in microseconds
+    std::vector<double> pauses;
+
+    // References a slice traces from one container before checking the clock
+    static constexpr size_t TRACE_CHUNK = 512;
+    // Traced objects below which marking stays on one thread
+    static constexpr size_t PARALLEL_MARK_MIN = 16384;
+
+    // Estimated heap bytes per object, including its list links
+    static constexpr size_t OBJECT_SIZE = sizeof(Object*) + 32;
+
+    // How many objects fit in a number of heap bytes, with a floor so tiny
+    // heaps do not collect on every few allocations
+    static size_t objectsIn(size_t bytes) { return std::max<size_t>(bytes / OBJECT_SIZE, 1024); }
+
+    // Traces the nursery, or the whole heap, and queues every object no
+    // root can reach. Returns how many were queued.
+    size_t collectGarbage(bool wholeHeap);
+
+    // Unlinks and deletes an object
+    void destroy(Object* obj);
+    void queue(Object* obj);
+    // Deletes the queued objects whose count is still zero, and the ones
+    // their destructors release in turn, without recursing. With a budget,
+    // stops once it is used up and leaves the rest queued.
+    void drainPending(Clock::duration budget = Clock::duration::max());
+    // Trial-deletes the graph below the buffered cycle roots
+    void collectCycles();
+
+    // The list an object is in
+    ObjectList& listOf(const Object* obj);
+    void recordPause(Clock::time_point start);
+    // Incremental cycle steps; the slices return false when time ran out
+    void startCycle();
+    void runSlice();
+    void finishCycle();
+    bool markSlice(Clock::time_point deadline);
+    void beginSweep();
+    void advanceSweep(const Object* from);
+    bool sweepSlice(Clock::time_point deadline);
+    // Frees the condemned objects nothing outside them refers to, keeps the
+    // rest and ends the cycle
+    size_t reclaimCondemned();
+    // Concurrent marking steps, on the script's thread: hands what the
+    // barrier shaded to the marker and returns true once marking is done;
+    // or stops the marker and takes back what it had left to trace
+    bool serviceMarker();
+    void stopMarker();
+    // On the marker thread
+    void markerLoop();
+    // Returns false if told to stop before running out of work
+    bool traceConcurrently();
+    // Drains the mark stack on every mark thread
+    void markInParallel();
+    void markWorker(size_t worker, std::atomic<size_t>& outstanding);
 
 public:
+    // Heap usage is only logged when a log file is given
     GarbageCollector(size_t initialHeapSize = 1024 * 1024, 
                     size_t maxHeapSize = 64 * 1024 * 1024,
-                    const std::string& logFile = "memory_usage.csv")
+                    const std::string& logFile = std::string())
         : isCollecting(false), 
           initialHeap(initialHeapSize), 
           maxHeap(maxHeapSize),
-          logger(std::make_unique<MemoryLogger>(logFile)),
-          interpreter(nullptr) {}
-
-    ~GarbageCollector() { 
-        try {
-            collect();
-        } catch (...) {
-            std::cerr << "Error during final garbage collection" << std::endl;
-        }
+          logger(std::make_unique<MemoryLogger>(logFile, !logFile.empty())),
+          interpreter(nullptr),
+          // The nursery gets a quarter of the initial heap
+          nurseryLimit(objectsIn(initialHeapSize / 4)),
+          candidateLimit(nurseryLimit),
+          cycleTrigger(objectsIn(initialHeapSize)) {
+        objectPool.setCollector(this);
+        objectPool.reserveHeap(maxHeapSize, initialHeapSize);
     }
 
+    // Runs a last full collection and stops the collector's threads
+    ~GarbageCollector();
+
     void setInterpreter(JeveInterpreter* interp) { interpreter = interp; }
     JeveInterpreter* getInterpreter() const { return interpreter; }
 
+    // Traces collections and allocations on the debug log
+    void setDebug(bool enabled) {
+        debug = enabled;
+        objectPool.setDebug(enabled);
+    }
+    bool isDebug() const { return debug; }
+
+    // The debug log: stdout unless the interpreter gives its own output
+    void setLog(std::ostream& out) {
+        log = &out;
+        objectPool.setLog(out);
+    }
+    std::ostream& getLog() const { return *log; }
+
+    // Runs major collections in slices of at most about sliceMicros each
+    void setIncremental(size_t sliceMicros) {
+        incremental = true;
+        sliceBudget = std::chrono::microseconds(std::max<size_t>(sliceMicros, 1));
+    }
+
+    // Marks on a background thread; sweeps and frees in slices like
+    // incremental mode
+    void setConcurrent(size_t sliceMicros) {
+        setIncremental(sliceMicros);
+        if (concurrent) return;
+        concurrent = true;
+        markerThread = std::thread(&GarbageCollector::markerLoop, this);
+    }
+
+    // Threads that mark a large collection; 0 uses every core
+    void setMarkThreads(size_t threads) { markThreads = threads; }
+
+    // Backs the heap with transparent huge pages where the system has them
+    void setHugePages(bool enabled) {
+        if (enabled) objectPool.useHugePages();
+    }
+
+    // Called at a safepoint of the script this collector runs for
+    void safepoint() {
+        if (safepointRaised.load(std::memory_order_relaxed)) runSlice();
+    }
+
     template<typename T, typename... Args>
     T* createObject(Args&&... args) {
+        if (AllocationBuffer* buffer = AllocationBuffer::current()) {
+            // A parallel loop is running: no collection, and the limit only
+            // counts this worker's new objects
+            if (getHeapUsage() + buffer->size() * OBJECT_SIZE >= maxHeap) {
+                throw std::runtime_error("Out of memory: max heap size reached");
+            }
+            T* obj = new T(std::forward<Args>(args)...);
+            obj->setPool(&objectPool);
+            buffer->add(obj);
+            return obj;
+        }
+
+        if (nursery.size() >= nurseryLimit) {
+            collectYoung();
+        }
+        if (candidates.size() >= candidateLimit) {
+            collectCycles();
+        }
+        if (phase != Phase::Idle || !pending.empty()) {
+            // Checking the clock on every allocation would cost more than it saves
+            if (++allocationsSinceCheck >= 32) {
+                allocationsSinceCheck = 0;
+                // The script runs for at least a slice's length between slices
+                if (Clock::now() - lastPauseEnd >= sliceBudget) runSlice();
+            }
+        } else if (incremental && getObjectCount() >= cycleTrigger) {
+            startCycle();
+        }
+
         // Calculate current memory usage
         size_t currentUsage = getHeapUsage();
         
@@ -110,8 +378,8 @@ public:
             // Check again after collection
             currentUsage = getHeapUsage();
             if (currentUsage >= maxHeap) {
-                std::cout << "Memory limit reached! Current usage: " << currentUsage 
-                          << " bytes, Max heap: " << maxHeap << " bytes" << std::endl;
+                // The error reaches the script's own error stream; the
+                // numbers are only traced in debug mode
                 printStats();
                 throw std::runtime_error("Out of memory: max heap size reached");
             }
@@ -120,7 +388,9 @@ public:
         // Create the object using the pool
         T* obj = objectPool.acquire<T>(std::forward<Args>(args)...);
         obj->setPool(&objectPool);
-        objects.push_back(obj);
+        nursery.push_back(obj);
+        // Allocated black: marking never visits it, sweeping keeps it
+        if (phase == Phase::Marking) obj->mark();
         
         // Log memory usage
         logger->logMemoryUsage(getObjectCount(), getHeapUsage(), initialHeap, maxHeap);
@@ -128,22 +398,38 @@ public:
         return obj;
     }
 
+    // Registers the objects the workers of a finished parallel loop created,
+    // then frees the ones they released
+    void adopt(const std::vector<AllocationBuffer>& buffers);
+
+    // Called by the pool when an object's last reference goes away
+    void reclaim(Object* obj);
+    // Called by the pool when an object may now be kept alive by a cycle only
+    void addCandidate(Object* obj);
+
     void mark(Object* obj);
-    void processMarkStack();
+    // Traces from the mark stack until it is empty, on every mark thread
+    // when at least PARALLEL_MARK_MIN objects are being traced
+    void processMarkStack(size_t traced = 0);
+    // Full collection of both generations; finishes an incremental cycle first
     void collect();
+    // clean_gc(): a full collection, or in incremental mode the start of a
+    // cycle if none is running
+    void requestCollection();
+    // Minor collection: sweeps the nursery and promotes what survives
+    void collectYoung();
     bool shouldCollect() const;
     void checkAndCollect();
 
     // Memory usage reporting
-    size_t getObjectCount() const { return objects.size(); }
+    size_t getObjectCount() const { return nursery.size() + tenured.size(); }
 
-    // Improved heap usage calculation
-    size_t getHeapUsage() const { 
-        // Base usage from object pointers
-        size_t usage = objects.size() * sizeof(Object*);
-        
-        // Add estimated size of each object
-        usage += objects.size() * 32;
+    // Bytes of slabs holding objects, plus an estimate for objects too
+    // large for a slab or created by parallel-loop workers
+    size_t getHeapUsage() const {
+        size_t objects = getObjectCount();
+        size_t inSlabs = std::min(objectPool.getSlabObjects(), objects);
+        size_t usage = objectPool.getSlabBytes() + (objects - inSlabs) * OBJECT_SIZE;
         
         // Add stack memory usage
         usage += markStack.size() * sizeof(Object*);
@@ -155,16 +441,26 @@ public:
     size_t getMaxHeap() const { return maxHeap; }
 
     void printStats() const {
-        if (g_jeve_debug) {
-            std::cout << "[GC] Objects: " << getObjectCount()
+        if (debug) {
+            *log << "[GC] Objects: " << getObjectCount()
+                      << " (young: " << nursery.size() << ", tenured: " << tenured.size() << ")"
+                      << ", Collections: " << minorCollections << " minor, " << majorCollections << " major, "
+                      << cycleCollections << " cycle"
                       << ", Heap usage: " << getHeapUsage() << " bytes"
                       << ", Initial heap: " << getInitialHeap() << " bytes"
                       << ", Max heap: " << getMaxHeap() << " bytes"
                       << ", Total allocations: " << logger->getTotalAllocations() << std::endl;
         }
+        if (debug) {
+            printPauses(*log);
+            objectPool.printSlabStats(*log);
+        }
         objectPool.printStats();
     }
 
+    // Number of pauses and their total, longest and 99th percentile length
+    void printPauses(std::ostream& out) const;
+
     // Memory logging control
     void enableLogging() { logger->enable(); }
     void disableLogging() { logger->disable(); }
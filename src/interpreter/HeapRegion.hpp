@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace jeve {
+
+// One contiguous range of address space holding every slab of a heap. The
+// whole maximum heap (-Xmx) is reserved up front, but only the initial heap
+// (-Xms) is committed; the rest is committed a chunk at a time as slabs are
+// needed. Freed slabs are reused lowest address first, so live data gathers
+// at the start of the region, and trim() hands the pages of chunks left with
+// no slab in use back to the operating system.
+class HeapRegion {
+public:
+    static constexpr size_t CHUNK_SIZE = 2 * 1024 * 1024;  // one huge page
+
+private:
+    char* base = nullptr;
+    size_t reserved = 0;
+    size_t committed = 0;
+    size_t slabSize = 0;
+    size_t slabsPerChunk = 0;
+    uint32_t nextSlab = 0;  // slabs below it have been handed out before
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> freeSlabs;
+    std::vector<uint32_t> slabsInUse;  // per chunk
+    std::vector<bool> resident;        // per chunk: touched since last trimmed
+    size_t idleChunks = 0;             // resident chunks with no slab in use
+    size_t trimmedBytes = 0;
+
+    static size_t roundUp(size_t bytes, size_t to) { return (bytes + to - 1) / to * to; }
+
+    static char* reserveAddressSpace(size_t bytes) {
+#ifdef _WIN32
+        return static_cast<char*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS));
+#else
+        void* memory = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        return memory == MAP_FAILED ? nullptr : static_cast<char*>(memory);
+#endif
+    }
+
+    static bool commitPages(char* start, size_t bytes) {
+#ifdef _WIN32
+        return VirtualAlloc(start, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+        return mprotect(start, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+    }
+
+    // The pages keep their addresses and read back as zeros
+    static void discardPages(char* start, size_t bytes) {
+#ifdef _WIN32
+        VirtualAlloc(start, bytes, MEM_RESET, PAGE_READWRITE);
+#else
+        madvise(start, bytes, MADV_DONTNEED);
+#endif
+    }
+
+    void release() {
+        if (!base) return;
+#ifdef _WIN32
+        VirtualFree(base, 0, MEM_RELEASE);
+#else
+        munmap(base, reserved);
+#endif
+        base = nullptr;
+    }
+
+public:
+    HeapRegion() = default;
+    ~HeapRegion() { release(); }
+
+    HeapRegion(const HeapRegion&) = delete;
+    HeapRegion& operator=(const HeapRegion&) = delete;
+
+    // Reserves room for maxBytes and commits initialBytes of it, both
+    // rounded up to whole chunks. False if the address space is not
+    // available; slabs must then come from elsewhere.
+    bool reserve(size_t maxBytes, size_t initialBytes, size_t slabBytes) {
+        release();
+        slabSize = slabBytes;
+        slabsPerChunk = CHUNK_SIZE / slabBytes;
+        size_t size = roundUp(maxBytes ? maxBytes : 1, CHUNK_SIZE);
+        if (size / slabBytes > UINT32_MAX) return false;
+#ifdef _WIN32
+        // Reservations are aligned to 64 KiB, which is all slabs need
+        base = reserveAddressSpace(size);
+        if (!base) return false;
+#else
+        // Over-reserve so the region can start on a chunk boundary, which
+        // huge pages need, then unmap the ends
+        char* raw = reserveAddressSpace(size + CHUNK_SIZE);
+        if (!raw) return false;
+        base = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(raw), CHUNK_SIZE));
+        if (base > raw) munmap(raw, base - raw);
+        munmap(base + size, raw + CHUNK_SIZE - base);
+#endif
+        reserved = size;
+        committed = 0;
+        nextSlab = 0;
+        freeSlabs = {};
+        slabsInUse.assign(size / CHUNK_SIZE, 0);
+        resident.assign(size / CHUNK_SIZE, false);
+        idleChunks = 0;
+        size_t initial = std::min(roundUp(initialBytes, CHUNK_SIZE), size);
+        if (initial && !commitPages(base, initial)) {
+            release();
+            return false;
+        }
+        committed = initial;
+        return true;
+    }
+
+    bool isReserved() const { return base != nullptr; }
+
+    // Asks for transparent huge pages; a hint the kernel may ignore
+    void useHugePages() {
+#if defined(MADV_HUGEPAGE)
+        if (base) madvise(base, reserved, MADV_HUGEPAGE);
+#endif
+    }
+
+    // A slab-aligned block of slabSize bytes, or nullptr once the whole
+    // region is in use
+    void* allocateSlab() {
+        uint32_t index;
+        if (!freeSlabs.empty()) {
+            index = freeSlabs.top();
+            freeSlabs.pop();
+        } else {
+            size_t end = static_cast<size_t>(nextSlab + 1) * slabSize;
+            if (end > reserved) return nullptr;
+            if (end > committed) {
+                if (!commitPages(base + committed, CHUNK_SIZE)) return nullptr;
+                committed += CHUNK_SIZE;
+            }
+            index = nextSlab++;
+        }
+        size_t chunk = index / slabsPerChunk;
+        if (slabsInUse[chunk]++ == 0 && resident[chunk]) --idleChunks;
+        resident[chunk] = true;
+        return base + static_cast<size_t>(index) * slabSize;
+    }
+
+    void releaseSlab(void* slab) {
+        uint32_t index = static_cast<uint32_t>((static_cast<char*>(slab) - base) / slabSize);
+        freeSlabs.push(index);
+        if (--slabsInUse[index / slabsPerChunk] == 0) ++idleChunks;
+    }
+
+    // Hands back the pages of every chunk with no slab in use; they stay
+    // committed and are faulted in again if their slabs are reused
+    void trim() {
+        if (idleChunks == 0) return;
+        for (size_t chunk = 0; chunk < resident.size(); ++chunk) {
+            if (!resident[chunk] || slabsInUse[chunk] != 0) continue;
+            discardPages(base + chunk * CHUNK_SIZE, CHUNK_SIZE);
+            resident[chunk] = false;
+            trimmedBytes += CHUNK_SIZE;
+        }
+        idleChunks = 0;
+    }
+
+    // Leaves the region mapped when the heap is destroyed, for objects that
+    // outlive it
+    void keepMapped() { base = nullptr; }
+
+    size_t getReserved() const { return reserved; }
+    size_t getCommitted() const { return committed; }
+    // Bytes handed back by trim() so far
+    size_t getTrimmed() const { return trimmedBytes; }
+};
+
+} // namespace jeve
@@ -0,0 +1,306 @@
+#include "HeapSnapshot.hpp"
+#include "JeveInterpreter.hpp"
+#include "MappedFile.hpp"
+#include "Program.hpp"
+#include "ProgramCache.hpp"
+#include "ProgramReader.hpp"
+#include "ast/FunctionNodes.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jeve {
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[4] = {'J', 'E', 'V', 'S'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t format;
+    uint32_t byteOrder;
+    uint32_t stringCount;
+    uint64_t version;
+    uint32_t functionCount;
+    uint32_t containerCount;
+    uint32_t globalCount;
+    uint32_t tableOffset;  // where the function table starts in the node stream
+};
+
+enum class ContainerKind : uint8_t { Array = 0, Map };
+
+// Numbers every array and map reachable from the globals, so shared and
+// cyclic containers are written once and referenced by id
+class SnapshotWriter {
+private:
+    ProgramWriter& out;
+    std::unordered_map<const UserFunctionNode*, uint32_t> functionIds;
+    std::unordered_map<const Object*, uint32_t> containerIds;
+    std::vector<Value> containers;  // keeps each container alive until it is written
+
+    uint32_t containerId(const Object* object, const Value& value) {
+        auto it = containerIds.find(object);
+        if (it != containerIds.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(containers.size());
+        containerIds.emplace(object, id);
+        containers.push_back(value);
+        return id;
+    }
+
+public:
+    SnapshotWriter(ProgramWriter& writer, const std::vector<UserFunctionNode*>& functions) : out(writer) {
+        for (size_t i = 0; i < functions.size(); ++i) {
+            functionIds.emplace(functions[i], static_cast<uint32_t>(i));
+        }
+    }
+
+    void value(const Value& v) {
+        out.u8(static_cast<uint8_t>(v.getType()));
+        switch (v.getType()) {
+            case Value::Type::Integer: out.i64(v.getInteger()); break;
+            case Value::Type::Float: out.f64(v.getFloat()); break;
+            case Value::Type::Boolean: out.u8(v.getBoolean() ? 1 : 0); break;
+            case Value::Type::String: out.string(v.getString()); break;
+            case Value::Type::Array: out.u32(containerId(v.getArrayObject().get(), v)); break;
+            case Value::Type::Map: out.u32(containerId(v.getMap().get(), v)); break;
+            case Value::Type::Range: {
+                const RangeValue& range = v.getRange();
+                out.i64(range.start);
+                out.i64(range.end);
+                out.i64(range.step);
+                break;
+            }
+            case Value::Type::Object: {
+                auto it = functionIds.find(dynamic_cast<const UserFunctionNode*>(v.getObject()));
+                if (it == functionIds.end()) {
+                    throw std::runtime_error("Cannot snapshot object " + v.getObject()->toString());
+                }
+                out.u32(it->second);
+                break;
+            }
+            case Value::Type::Null: break;
+        }
+    }
+
+    // Writes the contents of every container numbered so far, including the
+    // ones found while writing, and returns their kinds in id order
+    std::string containerContents() {
+        std::string kinds;
+        for (size_t i = 0; i < containers.size(); ++i) {
+            // Copy: writing may append to containers
+            Value container = containers[i];
+            if (container.getType() == Value::Type::Array) {
+                kinds.push_back(static_cast<char>(ContainerKind::Array));
+                const std::vector<Value>& elements = container.getArrayObject()->getElements();
+                out.u32(static_cast<uint32_t>(elements.size()));
+                for (size_t j = 0; j < elements.size(); ++j) value(elements[j]);
+            } else {
+                kinds.push_back(static_cast<char>(ContainerKind::Map));
+                Ref<ValueMap> map = container.getMap();
+                out.u32(static_cast<uint32_t>(map->size()));
+                for (size_t slot = 0; slot < map->capacity(); ++slot) {
+                    if (!map->occupied(slot)) continue;
+                    value(map->keyAt(slot));
+                    value(map->valueAt(slot));
+                }
+            }
+        }
+        return kinds;
+    }
+};
+
+class SnapshotReader {
+private:
+    ProgramReader& in;
+    const std::vector<UserFunctionNode*>& functions;
+    std::vector<Value> containers;
+
+    static void invalid(const char* what) { throw std::runtime_error(what); }
+
+public:
+    SnapshotReader(ProgramReader& reader, const std::vector<UserFunctionNode*>& fns) : in(reader), functions(fns) {}
+
+    // Containers are created empty first so values can refer to any of them
+    void createContainers(const char* kinds, uint32_t count, JeveInterpreter& interpreter) {
+        for (uint32_t i = 0; i < count; ++i) {
+            switch (static_cast<ContainerKind>(kinds[i])) {
+                case ContainerKind::Array:
+                    containers.emplace_back(std::vector<Value>(), interpreter.getGC().getObjectPool());
+                    break;
+                case ContainerKind::Map:
+                    containers.emplace_back(interpreter.createObject<ValueMap>());
+                    break;
+                default:
+                    invalid("Bad container kind");
+            }
+        }
+    }
+
+    Value value() {
+        uint8_t type = in.read<uint8_t>();
+        switch (static_cast<Value::Type>(type)) {
+            case Value::Type::Integer: return Value(in.i64());
+            case Value::Type::Float: return Value(in.f64());
+            case Value::Type::Boolean: return Value(in.read<uint8_t>() != 0);
+            case Value::Type::String: return Value(in.string());
+            case Value::Type::Array:
+            case Value::Type::Map: {
+                uint32_t id = in.u32();
+                if (id >= containers.size() || static_cast<uint8_t>(containers[id].getType()) != type) {
+                    invalid("Bad container reference");
+                }
+                return containers[id];
+            }
+            case Value::Type::Range: {
+                RangeValue range;
+                range.start = in.i64();
+                range.end = in.i64();
+                range.step = in.i64();
+                return Value(range);
+            }
+            case Value::Type::Object: {
+                uint32_t id = in.u32();
+                if (id >= functions.size()) invalid("Bad function reference");
+                return Value(Ref<Object>(functions[id]));
+            }
+            case Value::Type::Null: return Value();
+        }
+        invalid("Bad value type");
+        return Value();
+    }
+
+    void fillContainers() {
+        for (Value& container : containers) {
+            uint32_t count = in.u32();
+            if (container.getType() == Value::Type::Array) {
+                Ref<ValueArray> array = container.getArrayObject();
+                auto lock = array->writeLock();
+                std::vector<Value>& elements = array->getElements();
+                for (uint32_t i = 0; i < count; ++i) elements.push_back(value());
+            } else {
+                Ref<ValueMap> map = container.getMap();
+                for (uint32_t i = 0; i < count; ++i) {
+                    Value key = value();
+                    map->set(key, value());
+                }
+            }
+        }
+    }
+};
+
+} // namespace
+
+namespace HeapSnapshot {
+
+void save(JeveInterpreter& interpreter, const std::string& path) {
+    // Bodies are written in full, so parse any that have not run yet
+    std::vector<UserFunctionNode*> functions;
+    for (const auto& program : interpreter.getPrograms()) {
+        interpreter.compileFunctions(*program);
+        functions.insert(functions.end(), program->getFunctions().begin(), program->getFunctions().end());
+    }
+
+    ProgramWriter writer;
+    uint32_t tableOffset = writer.functionTable(functions);
+
+    // Sorted so the same state always gives the same file
+    std::vector<std::pair<const std::string*, const Value*>> globals;
+    for (const auto& entry : interpreter.getGlobalScope()->getSymbols()) {
+        globals.emplace_back(&entry.first, &entry.second);
+    }
+    std::sort(globals.begin(), globals.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+
+    SnapshotWriter values(writer, functions);
+    for (const auto& global : globals) {
+        writer.string(*global.first);
+        values.value(*global.second);
+    }
+    // Containers are only known once everything before them is written, so
+    // their kinds go in a table ahead of the string pool
+    std::string kinds = values.containerContents();
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.format = FORMAT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.stringCount = static_cast<uint32_t>(writer.getStrings().size());
+    header.version = ProgramCache::key(std::string_view());
+    header.functionCount = static_cast<uint32_t>(functions.size());
+    header.containerCount = static_cast<uint32_t>(kinds.size());
+    header.globalCount = static_cast<uint32_t>(globals.size());
+    header.tableOffset = tableOffset;
+
+    std::string pool = writer.encodeStrings();
+    if (!ProgramCache::writeFile(path, {std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)),
+                                        kinds, pool, writer.getBody()})) {
+        throw std::runtime_error("Could not write snapshot: " + path);
+    }
+}
+
+void load(JeveInterpreter& interpreter, const std::string& path) {
+    auto program = std::make_unique<Program>();
+    auto bodies = std::make_unique<MappedBodies>(path, interpreter, *program, "snapshot");
+    const MappedFile& file = bodies->getFile();
+    if (!file.getData()) {
+        throw std::runtime_error("Could not open snapshot: " + path);
+    }
+    SnapshotHeader header;
+    if (file.getSize() < sizeof(header)) {
+        throw std::runtime_error("Not a Jeve snapshot: " + path);
+    }
+    std::memcpy(&header, file.getData(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.byteOrder != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Not a Jeve snapshot: " + path);
+    }
+    if (header.format != FORMAT_VERSION || header.version != ProgramCache::key(std::string_view())) {
+        throw std::runtime_error("Snapshot was made by another version of Jeve: " + path);
+    }
+
+    std::vector<std::pair<std::string, Value>> globals;
+    try {
+        const char* kinds = file.getData() + sizeof(header);
+        const char* end = file.getData() + file.getSize();
+        if (static_cast<size_t>(end - kinds) < header.containerCount) {
+            throw std::runtime_error("Unexpected end of compiled data");
+        }
+        ProgramReader pool(kinds + header.containerCount, end, interpreter, *program);
+        pool.readStrings(header.stringCount);
+        if (static_cast<size_t>(end - pool.position()) < header.tableOffset) {
+            throw std::runtime_error("Bad function table offset");
+        }
+        const char* table = pool.position() + header.tableOffset;
+        bodies->setBodies(pool.getStrings(), pool.position(), table);
+
+        ProgramReader reader(table, end, interpreter, *program, pool.getStrings());
+        reader.functionTable(header.functionCount, header.tableOffset);
+
+        SnapshotReader values(reader, program->getFunctions());
+        values.createContainers(kinds, header.containerCount, interpreter);
+        globals.reserve(header.globalCount);
+        for (uint32_t i = 0; i < header.globalCount; ++i) {
+            std::string name = reader.string();
+            globals.emplace_back(std::move(name), values.value());
+        }
+        values.fillContainers();
+        if (!reader.atEnd()) {
+            throw std::runtime_error("Trailing bytes after the last value");
+        }
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Invalid snapshot " + path + ": " + e.what());
+    }
+
+    // Nothing is installed until the whole file has been read
+    program->setBodyDecoder(std::move(bodies));
+    for (auto& global : globals) {
+        interpreter.getGlobalScope()->set(global.first, std::move(global.second));
+    }
+    interpreter.adoptProgram(std::move(program));
+}
+
+} // namespace HeapSnapshot
+
+} // namespace jeve
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace jeve {
+
+class JeveInterpreter;
+
+// Saved global state of an interpreter: every global variable, the arrays,
+// maps and strings reachable from them, and the functions they name. A
+// script can be run once to build its tables and the result loaded by later
+// runs instead of running it again.
+namespace HeapSnapshot {
+
+constexpr uint32_t FORMAT_VERSION = 1;
+
+// Throws std::runtime_error if a global holds a value that cannot be saved
+// or the file cannot be written
+void save(JeveInterpreter& interpreter, const std::string& path);
+
+// Maps the file and recreates its globals in the interpreter, keeping the
+// sharing between arrays and maps. Throws std::runtime_error if the file is
+// missing, corrupt or from another interpreter version.
+void load(JeveInterpreter& interpreter, const std::string& path);
+
+} // namespace HeapSnapshot
+
+} // namespace jeve
@@ -1,11 +1,18 @@
 #include "JeveInterpreter.hpp"
 #include <iostream>
-#include <sstream>
-#include <cctype>
 #include <stdexcept>
-#include <unordered_map>
+#include <string_view>
+#include <charconv>
+#include <chrono>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <utility>
 #include <vector>
 #include "ASTNode.hpp"
+#include "CharScan.hpp"
+#include "ProgramCache.hpp"
 #include "ast/ArrayNodes.hpp"
 #include "ast/ControlFlowNodes.hpp"
 #include "ast/OperatorNodes.hpp"
@@ -20,752 +27,1144 @@
 
 namespace jeve {
 
-class ParseError : public std::runtime_error {
-private:
-    size_t line;
-    size_t column;
-
-public:
-    ParseError(const std::string& message, size_t l, size_t c)
-        : std::runtime_error(message), line(l), column(c) {}
-
-    std::string getFormattedMessage() const {
-        std::ostringstream oss;
-        oss << "Error at line " << line << ", column " << column << ": " << what();
-        return oss.str();
-    }
-};
-
 // Lexer implementation
 enum class TokenType {
     NUMBER,
     STRING,
     IDENTIFIER,
-    KEYWORD,
-    OPERATOR,
-    PUNCTUATION,
     TYPE,
-    EOF_TOKEN
+    EOF_TOKEN,
+
+    // Operators
+    PLUS,
+    MINUS,
+    STAR,
+    SLASH,
+    PERCENT,
+    ASSIGN,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    GREATER,
+    LESS_EQUAL,
+    GREATER_EQUAL,
+    NOT,
+    AND,
+    OR,
+
+    // Punctuation
+    SEMICOLON,
+    LPAREN,
+    RPAREN,
+    LBRACE,
+    RBRACE,
+    LBRACKET,
+    RBRACKET,
+    COLON,
+    COMMA,
+    DOT,
+
+    // Keywords
+    KW_PRINT,
+    KW_IF,
+    KW_ELSE,
+    KW_WHILE,
+    KW_FOR,
+    KW_IN,
+    KW_TO,
+    KW_STEP,
+    KW_TRUE,
+    KW_FALSE,
+    KW_FUNCTION,
+    KW_RETURN
 };
 
+// Tokens point into the program's source buffer instead of owning their text.
+// Positions are byte offsets; line and column are only worked out for errors.
 struct Token {
     TokenType type;
-    std::string value;
-    size_t line;
-    size_t column;
+    std::string_view text;
+    size_t offset;
 };
 
 class Lexer {
 private:
-    std::string input;
+    std::string_view input;
     size_t position;
-    size_t line;
-    size_t column;
-    static const std::unordered_map<std::string, TokenType> keywords;
-    static const std::unordered_map<std::string, TokenType> types;
 
 public:
-    Lexer(const std::string& code) 
-        : input(code), position(0), line(1), column(1) {}
+    Lexer(std::string_view code, size_t start = 0)
+        : input(code), position(start) {}
 
     Token nextToken() {
-        while (position < input.length()) {
-            char current = input[position];
-            
-            // Handle comments
-            if (current == '/' && position + 1 < input.length() && input[position + 1] == '/') {
-                // Skip to end of line
-                while (position < input.length() && input[position] != '\n') {
-                    position++;
-                    column++;
-                }
-                continue;
+        const char* data = input.data();
+        const size_t length = input.length();
+        while (position < length) {
+            position = scan::skipSpaces(data, position, length);
+            if (position >= length) {
+                break;
             }
-            
-            if (std::isspace(current)) {
-                if (current == '\n') {
-                    line++;
-                    column = 1;
-                } else {
-                    column++;
-                }
-                position++;
+
+            char current = data[position];
+
+            // Handle comments
+            if (current == '/' && position + 1 < length && data[position + 1] == '/') {
+                position = scan::findByte(data, position + 2, length, '\n');
                 continue;
             }
-            
-            if (std::isdigit(current) || (current == '.' && position + 1 < input.length() && std::isdigit(input[position + 1]))) {
+
+            if (scan::is(current, scan::CHAR_DIGIT) ||
+                (current == '.' && position + 1 < length && scan::is(data[position + 1], scan::CHAR_DIGIT))) {
                 return readFloatOrInt();
             }
-            
+
             if (current == '"') {
                 return readString();
             }
-            
-            if (std::isalpha(current) || current == '_') {
+
+            if (scan::is(current, scan::CHAR_IDENT_START)) {
                 return readIdentifier();
             }
-            
-            if (current == '+' || current == '-' || current == '*' || current == '/' || 
-                current == '%' || current == '=' || current == '<' || current == '>' || 
-                current == '!' || current == '&' || current == '|') {
-                return readOperator();
-            }
-            
-            if (current == ';' || current == '(' || current == ')' || 
-                current == '{' || current == '}' || current == ':' || current == ',' ||
-                current == '[' || current == ']') {
-                position++;
-                column++;
-                return {TokenType::PUNCTUATION, std::string(1, current), line, column - 1};
-            }
-            
-            throw ParseError("Unexpected character: " + std::string(1, current), line, column);
+
+            return readSymbol();
         }
-        
-        return {TokenType::EOF_TOKEN, "", line, column};
+
+        return {TokenType::EOF_TOKEN, std::string_view(), length};
     }
 
-private:
-    Token readNumber() {
-        size_t start = position;
-        while (position < input.length() && std::isdigit(input[position])) {
-            position++;
-            column++;
+    // 1-based line and column of a byte offset, found by counting newlines
+    std::pair<size_t, size_t> locate(size_t offset) const {
+        offset = std::min(offset, input.length());
+        size_t line = 1;
+        size_t lineStart = 0;
+        size_t newline = scan::findByte(input.data(), 0, offset, '\n');
+        while (newline < offset) {
+            line++;
+            lineStart = newline + 1;
+            newline = scan::findByte(input.data(), lineStart, offset, '\n');
         }
-        return {TokenType::NUMBER, input.substr(start, position - start), line, column - (position - start)};
+        return {line, offset - lineStart + 1};
     }
-    
-    Token readString() {
-        position++; // Skip opening quote
-        column++;
-        size_t start = position;
-        while (position < input.length() && input[position] != '"') {
-            if (input[position] == '\n') {
-                line++;
-                column = 1;
-            } else {
-                column++;
+
+    // Skips to just past the '}' matching an already consumed '{', looking
+    // only at braces, strings and comments. Returns the new position.
+    size_t skipBlock() {
+        const char* data = input.data();
+        const size_t length = input.length();
+        size_t depth = 1;
+        while (position < length) {
+            char current = data[position];
+            if (current == '{') {
+                depth++;
+            } else if (current == '}') {
+                if (--depth == 0) {
+                    return ++position;
+                }
+            } else if (current == '"') {
+                position = scan::findByte(data, position + 1, length, '"');
+                if (position >= length) {
+                    throw error("Unterminated string literal", length);
+                }
+            } else if (current == '/' && position + 1 < length && data[position + 1] == '/') {
+                position = scan::findByte(data, position + 2, length, '\n');
+                continue;
             }
             position++;
         }
+        throw error("Expected '}' to close function body", length);
+    }
+
+    ParseError error(const std::string& message, size_t offset) const {
+        auto location = locate(offset);
+        return ParseError(message, location.first, location.second);
+    }
+
+private:
+    Token makeToken(TokenType type, size_t start) {
+        return {type, input.substr(start, position - start), start};
+    }
+
+    Token readString() {
+        size_t quote = position;
+        size_t start = position + 1; // Skip opening quote
+        position = scan::findByte(input.data(), start, input.length(), '"');
         if (position >= input.length()) {
-            throw ParseError("Unterminated string literal", line, column);
+            throw error("Unterminated string literal", position);
         }
-        std::string value = input.substr(start, position - start);
+        std::string_view value = input.substr(start, position - start);
         position++; // Skip closing quote
-        column++;
-        return {TokenType::STRING, value, line, column - value.length() - 2};
+        return {TokenType::STRING, value, quote};
     }
     
     Token readIdentifier() {
         size_t start = position;
-        while (position < input.length() && (std::isalnum(input[position]) || input[position] == '_')) {
-            position++;
-            column++;
-        }
-        // Check for array brackets after type
-        std::string value = input.substr(start, position - start);
+        position = scan::skipIdentifier(input.data(), position + 1, input.length());
+        size_t nameEnd = position;
+        // Array brackets directly after a name are part of the token, e.g. int[][]
+        size_t dimensions = 0;
         while (position + 1 < input.length() && input[position] == '[' && input[position + 1] == ']') {
-            value += "[]";
             position += 2;
-            column += 2;
+            dimensions++;
         }
-        if (value.empty()) {
-            throw ParseError("Lexer error: empty identifier encountered", line, column);
+        std::string_view name = input.substr(start, nameEnd - start);
+        if (dimensions == 0) {
+            TokenType keyword = keywordType(name);
+            if (keyword != TokenType::IDENTIFIER) {
+                return makeToken(keyword, start);
+            }
         }
-        // Check if it's a keyword
-        auto it = keywords.find(value);
-        if (it != keywords.end()) {
-            return {it->second, value, line, column - value.length()};
+        if (dimensions <= 2 && isTypeName(name)) {
+            return makeToken(TokenType::TYPE, start);
         }
-        // Check if it's a type (including array types)
-        auto typeIt = types.find(value);
-        if (typeIt != types.end()) {
-            return {TokenType::TYPE, value, line, column - value.length()};
+        return makeToken(TokenType::IDENTIFIER, start);
+    }
+
+    static TokenType keywordType(std::string_view word) {
+        switch (word[0]) {
+            case 'e': if (word == "else") return TokenType::KW_ELSE; break;
+            case 'f':
+                if (word == "for") return TokenType::KW_FOR;
+                if (word == "false") return TokenType::KW_FALSE;
+                if (word == "function") return TokenType::KW_FUNCTION;
+                break;
+            case 'i':
+                if (word == "if") return TokenType::KW_IF;
+                if (word == "in") return TokenType::KW_IN;
+                break;
+            case 'p': if (word == "print") return TokenType::KW_PRINT; break;
+            case 'r': if (word == "return") return TokenType::KW_RETURN; break;
+            case 's': if (word == "step") return TokenType::KW_STEP; break;
+            case 't':
+                if (word == "to") return TokenType::KW_TO;
+                if (word == "true") return TokenType::KW_TRUE;
+                break;
+            case 'w': if (word == "while") return TokenType::KW_WHILE; break;
+            default: break;
         }
-        return {TokenType::IDENTIFIER, value, line, column - value.length()};
+        return TokenType::IDENTIFIER;
     }
 
-    Token readOperator() {
+    static bool isTypeName(std::string_view word) {
+        return word == "int" || word == "string" || word == "float" || word == "bool";
+    }
+
+    Token readSymbol() {
+        size_t start = position;
         char current = input[position];
+        char next = position + 1 < input.length() ? input[position + 1] : '\0';
         position++;
-        column++;
         
         // Handle two-character operators
-        if (position < input.length()) {
-            char next = input[position];
-            if ((current == '=' && next == '=') ||
-                (current == '!' && next == '=') ||
-                (current == '<' && next == '=') ||
-                (current == '>' && next == '=')
-            ) {
+        if ((current == '&' || current == '|') && next == current) {
+            position++;
+            return makeToken(current == '&' ? TokenType::AND : TokenType::OR, start);
+        }
+        if (next == '=') {
+            TokenType type = TokenType::EOF_TOKEN;
+            switch (current) {
+                case '=': type = TokenType::EQUAL; break;
+                case '!': type = TokenType::NOT_EQUAL; break;
+                case '<': type = TokenType::LESS_EQUAL; break;
+                case '>': type = TokenType::GREATER_EQUAL; break;
+                default: break;
+            }
+            if (type != TokenType::EOF_TOKEN) {
                 position++;
-                column++;
-                return {TokenType::OPERATOR, std::string(1, current) + next, line, column - 2};
+                return makeToken(type, start);
             }
         }
         
-        // Handle single-character operators including !
-        if (current == '!' || current == '+' || current == '-' || current == '*' || 
-            current == '/' || current == '%' || current == '=' || current == '<' || 
-            current == '>' || current == '&' || current == '|') {
-            return {TokenType::OPERATOR, std::string(1, current), line, column - 1};
+        switch (current) {
+            case '+': return makeToken(TokenType::PLUS, start);
+            case '-': return makeToken(TokenType::MINUS, start);
+            case '*': return makeToken(TokenType::STAR, start);
+            case '/': return makeToken(TokenType::SLASH, start);
+            case '%': return makeToken(TokenType::PERCENT, start);
+            case '=': return makeToken(TokenType::ASSIGN, start);
+            case '<': return makeToken(TokenType::LESS, start);
+            case '>': return makeToken(TokenType::GREATER, start);
+            case '!': return makeToken(TokenType::NOT, start);
+            case '&': return makeToken(TokenType::AND, start);
+            case '|': return makeToken(TokenType::OR, start);
+            case ';': return makeToken(TokenType::SEMICOLON, start);
+            case '(': return makeToken(TokenType::LPAREN, start);
+            case ')': return makeToken(TokenType::RPAREN, start);
+            case '{': return makeToken(TokenType::LBRACE, start);
+            case '}': return makeToken(TokenType::RBRACE, start);
+            case '[': return makeToken(TokenType::LBRACKET, start);
+            case ']': return makeToken(TokenType::RBRACKET, start);
+            case ':': return makeToken(TokenType::COLON, start);
+            case ',': return makeToken(TokenType::COMMA, start);
+            case '.': return makeToken(TokenType::DOT, start);
+            default: break;
         }
         
-        throw ParseError("Invalid operator: " + std::string(1, current), line, column - 1);
+        throw error("Unexpected character: " + std::string(1, current), start);
     }
 
     Token readFloatOrInt() {
         size_t start = position;
         bool seenDot = false;
-        while (position < input.length() && (std::isdigit(input[position]) || input[position] == '.')) {
+        while (position < input.length() &&
+               (scan::is(input[position], scan::CHAR_DIGIT) || input[position] == '.')) {
             if (input[position] == '.') {
                 if (seenDot) break; // Only one dot allowed
                 seenDot = true;
             }
             position++;
-            column++;
-        }
-        std::string numStr = input.substr(start, position - start);
-        if (seenDot) {
-            return {TokenType::NUMBER, numStr, line, column - (position - start)}; // We'll distinguish in parser
-        } else {
-            return {TokenType::NUMBER, numStr, line, column - (position - start)};
         }
+        return makeToken(TokenType::NUMBER, start); // The parser tells floats from integers
     }
 };
 
-// Initialize static members
-const std::unordered_map<std::string, TokenType> Lexer::keywords = {
-    {"print", TokenType::KEYWORD},
-    {"if", TokenType::KEYWORD},
-    {"else", TokenType::KEYWORD},
-    {"while", TokenType::KEYWORD},
-    {"for", TokenType::KEYWORD},
-    {"in", TokenType::KEYWORD},
-    {"to", TokenType::KEYWORD},
-    {"step", TokenType::KEYWORD},
-    {"true", TokenType::KEYWORD},
-    {"false", TokenType::KEYWORD},
-    {"function", TokenType::KEYWORD}
+// Binding power of each infix operator, from loosest to tightest.
+// Tokens with PREC_NONE end an expression.
+enum Precedence : uint8_t {
+    PREC_NONE = 0,
+    PREC_OR,
+    PREC_AND,
+    PREC_EQUALITY,
+    PREC_COMPARISON,
+    PREC_ADDITIVE,
+    PREC_MULTIPLICATIVE
 };
 
-const std::unordered_map<std::string, TokenType> Lexer::types = {
-    {"int", TokenType::TYPE},
-    {"string", TokenType::TYPE},
-    {"float", TokenType::TYPE},
-    {"bool", TokenType::TYPE},
-    {"int[]", TokenType::TYPE},
-    {"string[]", TokenType::TYPE},
-    {"float[]", TokenType::TYPE},
-    {"bool[]", TokenType::TYPE},
-    {"int[][]", TokenType::TYPE},
-    {"string[][]", TokenType::TYPE},
-    {"float[][]", TokenType::TYPE},
-    {"bool[][]", TokenType::TYPE}
+struct InfixRule {
+    uint8_t precedence;
+    BinaryOperator op;
 };
 
+// KW_RETURN is the last TokenType
+constexpr size_t TOKEN_TYPE_COUNT = static_cast<size_t>(TokenType::KW_RETURN) + 1;
+
+constexpr std::array<InfixRule, TOKEN_TYPE_COUNT> makeInfixRules() {
+    std::array<InfixRule, TOKEN_TYPE_COUNT> rules{};
+    rules[static_cast<size_t>(TokenType::OR)] = {PREC_OR, BinaryOperator::Or};
+    rules[static_cast<size_t>(TokenType::AND)] = {PREC_AND, BinaryOperator::And};
+    rules[static_cast<size_t>(TokenType::EQUAL)] = {PREC_EQUALITY, BinaryOperator::Equal};
+    rules[static_cast<size_t>(TokenType::NOT_EQUAL)] = {PREC_EQUALITY, BinaryOperator::NotEqual};
+    rules[static_cast<size_t>(TokenType::LESS)] = {PREC_COMPARISON, BinaryOperator::Less};
+    rules[static_cast<size_t>(TokenType::GREATER)] = {PREC_COMPARISON, BinaryOperator::Greater};
+    rules[static_cast<size_t>(TokenType::LESS_EQUAL)] = {PREC_COMPARISON, BinaryOperator::LessEqual};
+    rules[static_cast<size_t>(TokenType::GREATER_EQUAL)] = {PREC_COMPARISON, BinaryOperator::GreaterEqual};
+    rules[static_cast<size_t>(TokenType::PLUS)] = {PREC_ADDITIVE, BinaryOperator::Add};
+    rules[static_cast<size_t>(TokenType::MINUS)] = {PREC_ADDITIVE, BinaryOperator::Subtract};
+    rules[static_cast<size_t>(TokenType::STAR)] = {PREC_MULTIPLICATIVE, BinaryOperator::Multiply};
+    rules[static_cast<size_t>(TokenType::SLASH)] = {PREC_MULTIPLICATIVE, BinaryOperator::Divide};
+    rules[static_cast<size_t>(TokenType::PERCENT)] = {PREC_MULTIPLICATIVE, BinaryOperator::Modulo};
+    return rules;
+}
+
+constexpr std::array<InfixRule, TOKEN_TYPE_COUNT> INFIX_RULES = makeInfixRules();
+
 // Parser implementation
 class Parser {
 private:
     Lexer lexer;
     Token currentToken;
     JeveInterpreter& interpreter;
+    Program& program;
+    Arena& arena;
+    std::vector<UserFunctionNode*> functions;  // definitions met so far, in source order
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        return arena.create<T>(std::forward<Args>(args)...);
+    }
 
 public:
-    Parser(const std::string& code, JeveInterpreter& interp)
-        : lexer(code), interpreter(interp) {
-        currentToken = lexer.nextToken();
+    // Nodes go into the given arena, which is the program's own unless a
+    // function body is being compiled on another thread
+    Parser(std::string_view code, JeveInterpreter& interp, Program& prog, Arena& nodes, size_t start = 0)
+        : lexer(code, start), interpreter(interp), program(prog), arena(nodes) {
+        advance();
     }
 
-    Ref<ASTNode> parse();
-    Ref<ASTNode> parseStatement();
-    bool isEOF() const { return currentToken.type == TokenType::EOF_TOKEN; }
+    void parseProgram();
+    BlockNode* parseFunctionBody();
+    ASTNode* parseStatement();
+    bool isEOF() const { return check(TokenType::EOF_TOKEN); }
+    std::vector<UserFunctionNode*>& getFunctions() { return functions; }
 
 private:
-    Ref<ASTNode> parseExpression() {
-        Ref<ASTNode> left = parseTerm();
-        
-        while (currentToken.type == TokenType::OPERATOR &&
-               (currentToken.value == "+" || currentToken.value == "-" ||
-                currentToken.value == "==" || currentToken.value == "!=" ||
-                currentToken.value == "<" || currentToken.value == ">" ||
-                currentToken.value == "<=" || currentToken.value == ">=" ||
-                currentToken.value == "&" || currentToken.value == "|"
-                )) {
-            std::string op = currentToken.value;
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> right = parseTerm();
-            
-            if (op == "+") {
-                // Check if either operand is a string for concatenation
-                if (left->evaluate(interpreter.getCurrentScope()).getType() == Value::Type::String ||
-                    right->evaluate(interpreter.getCurrentScope()).getType() == Value::Type::String) {
-                    left = interpreter.createObject<ConcatNode>(left, right);
-                } else {
-                    left = interpreter.createObject<BinaryOpNode>(left, right, op);
+    bool check(TokenType type) const { return currentToken.type == type; }
+    void advance() { currentToken = lexer.nextToken(); }
+    std::string currentText() const { return std::string(currentToken.text); }
+
+    // Literal strings make the result of '+' a string regardless of the other operand
+    static bool isStringExpression(ASTNode* node) {
+        return dynamic_cast<StringNode*>(node) || dynamic_cast<ConcatNode*>(node);
+    }
+
+    template<typename List>
+    void parseList(TokenType close, const char* error, List& items) {
+        if (!check(close)) {
+            do {
+                items.push_back(parseExpression());
+                if (check(close)) {
+                    break;
                 }
-            } else {
-                left = interpreter.createObject<BinaryOpNode>(left, right, op);
-            }
+                if (!check(TokenType::COMMA)) {
+                    throw lexer.error(error, currentToken.offset);
+                }
+                advance();
+            } while (true);
         }
-        
-        return left;
+        advance(); // Skip the closing token
     }
 
-    Ref<ASTNode> parseTerm() {
-        Ref<ASTNode> left = parseFactor();
-        
-        while (currentToken.type == TokenType::OPERATOR &&
-               (currentToken.value == "*" || currentToken.value == "/" || currentToken.value == "%")) {
-            std::string op = currentToken.value;
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> right = parseFactor();
-            left = interpreter.createObject<BinaryOpNode>(left, right, op);
+    // parallel for i = a to b [step s] [reduce(sum: x, min: y, max: z)] { ... },
+    // entered with 'for' as the current token
+    ASTNode* parseParallelFor() {
+        advance(); // Skip 'for'
+        if (!check(TokenType::IDENTIFIER)) {
+            throw lexer.error("Expected identifier after 'parallel for'", currentToken.offset);
         }
-        
-        return left;
+        std::string varName = currentText();
+        advance();
+        if (!check(TokenType::ASSIGN)) {
+            throw lexer.error("Expected '=' in parallel for loop", currentToken.offset);
+        }
+        advance();
+        ASTNode* start = parseExpression();
+        if (!check(TokenType::KW_TO)) {
+            throw lexer.error("Expected 'to' in parallel for loop", currentToken.offset);
+        }
+        advance();
+        ASTNode* end = parseExpression();
+        ASTNode* step = make<NumberNode>(1);
+        if (check(TokenType::KW_STEP)) {
+            advance();
+            step = parseExpression();
+        }
+        std::vector<ReductionVariable> reductions;
+        if (check(TokenType::IDENTIFIER) && currentToken.text == "reduce") {
+            advance();
+            if (!check(TokenType::LPAREN)) {
+                throw lexer.error("Expected '(' after reduce", currentToken.offset);
+            }
+            advance();
+            do {
+                Reduction op;
+                if (check(TokenType::IDENTIFIER) && currentToken.text == "sum") {
+                    op = Reduction::Sum;
+                } else if (check(TokenType::IDENTIFIER) && currentToken.text == "min") {
+                    op = Reduction::Min;
+                } else if (check(TokenType::IDENTIFIER) && currentToken.text == "max") {
+                    op = Reduction::Max;
+                } else {
+                    throw lexer.error("Expected sum, min or max in reduce", currentToken.offset);
+                }
+                advance();
+                if (!check(TokenType::COLON)) {
+                    throw lexer.error("Expected ':' after reduction", currentToken.offset);
+                }
+                advance();
+                if (!check(TokenType::IDENTIFIER)) {
+                    throw lexer.error("Expected variable name in reduce", currentToken.offset);
+                }
+                reductions.push_back({op, currentText()});
+                advance();
+                if (check(TokenType::RPAREN)) {
+                    break;
+                }
+                if (!check(TokenType::COMMA)) {
+                    throw lexer.error("Expected ',' or ')' in reduce", currentToken.offset);
+                }
+                advance();
+            } while (true);
+            advance();
+        }
+        if (!check(TokenType::LBRACE)) {
+            throw lexer.error("Expected '{' after parallel for loop header", currentToken.offset);
+        }
+        advance();
+        BlockNode* body = make<BlockNode>();
+        while (!check(TokenType::RBRACE)) {
+            body->addStatement(parseStatement());
+        }
+        advance();
+        return make<ParallelForNode>(varName, start, end, step, body, std::move(reductions), &interpreter);
     }
 
-    Ref<ASTNode> parseFactor() {
-        if (currentToken.type == TokenType::OPERATOR && currentToken.value == "!") {
-            std::string op = currentToken.value;
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> operand = parseFactor();
-            return interpreter.createObject<UnaryOpNode>(operand, op);
-        }
-        
-        if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "(") {
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> expr = parseExpression();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                throw ParseError("Expected closing parenthesis", 
-                               currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            return expr;
-        }
-        else if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "[") {
-            // Array literal
-            currentToken = lexer.nextToken();
-            std::vector<Ref<ASTNode>> elements;
-            
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "]") {
-                do {
-                    elements.push_back(parseExpression());
-                    if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "]") {
-                        break;
-                    }
-                    if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ",") {
-                        throw ParseError("Expected ',' or ']' in array literal", 
-                                       currentToken.line, currentToken.column);
-                    }
-                    currentToken = lexer.nextToken();
-                } while (true);
-            }
-            // Make sure we advance past the closing bracket
-            currentToken = lexer.nextToken();
+    ASTNode* parseExpression(uint8_t minPrecedence = PREC_OR) {
+        return parseInfix(parsePrefix(), minPrecedence);
+    }
+
+    // Folds operators into left for as long as they bind at least as tightly
+    // as minPrecedence. The right operand of a left-associative operator only
+    // takes operators that bind strictly tighter.
+    ASTNode* parseInfix(ASTNode* left, uint8_t minPrecedence) {
+        while (true) {
+            const InfixRule& rule = INFIX_RULES[static_cast<size_t>(currentToken.type)];
+            if (rule.precedence == PREC_NONE || rule.precedence < minPrecedence) {
+                return left;
+            }
+            advance();
+            ASTNode* right = parseExpression(rule.precedence + 1);
             
-            return interpreter.createObject<ArrayNode>(elements);
-        }
-        
-        Token token = currentToken;
-        currentToken = lexer.nextToken();
-        
-        if (token.type == TokenType::NUMBER) {
-            if (token.value.find('.') != std::string::npos) {
-                return interpreter.createObject<NumberNode>(std::stod(token.value)); // Use double for float
+            if (rule.op == BinaryOperator::Add && (isStringExpression(left) || isStringExpression(right))) {
+                left = make<ConcatNode>(left, right);
             } else {
-                return interpreter.createObject<NumberNode>(std::stoll(token.value));
+                left = make<BinaryOpNode>(left, right, rule.op);
             }
         }
-        
-        if (token.type == TokenType::STRING) {
-            return interpreter.createObject<StringNode>(token.value);
+    }
+
+    ASTNode* parsePrefix() {
+        if (check(TokenType::NOT) || check(TokenType::MINUS)) {
+            UnaryOperator op = check(TokenType::NOT) ? UnaryOperator::Not : UnaryOperator::Negate;
+            advance();
+            // Unary operators bind tighter than any binary operator
+            ASTNode* operand = parsePrefix();
+            if (op == UnaryOperator::Negate) {
+                if (auto* number = dynamic_cast<NumberNode*>(operand)) {
+                    return make<NumberNode>(-number->getValue());
+                }
+            }
+            return make<UnaryOpNode>(operand, op);
         }
-        
-        if (token.type == TokenType::KEYWORD) {
-            if (token.value == "true") {
-                return interpreter.createObject<BooleanNode>(true);
-            } else if (token.value == "false") {
-                return interpreter.createObject<BooleanNode>(false);
+        return parsePostfix(parsePrimary());
+    }
+
+    // Indexing and property access apply to any primary expression
+    ASTNode* parsePostfix(ASTNode* node) {
+        while (true) {
+            if (check(TokenType::LBRACKET)) {
+                advance();
+                ASTNode* index = parseExpression();
+                if (!check(TokenType::RBRACKET)) {
+                    throw lexer.error("Expected ']' after array index", currentToken.offset);
+                }
+                advance();
+                node = make<ArrayAccessNode>(node, index);
+            } else if (check(TokenType::DOT)) {
+                advance();
+                if (!check(TokenType::IDENTIFIER)) {
+                    throw lexer.error("Expected property name after '.'", currentToken.offset);
+                }
+                std::string property = currentText();
+                advance();
+                if (property != "length") {
+                    throw lexer.error("Unknown property: " + property, currentToken.offset);
+                }
+                node = make<PropertyAccessNode>(node, property);
+            } else {
+                return node;
             }
         }
+    }
+
+    ASTNode* parsePrimary() {
+        Token token = currentToken;
+        advance();
         
-        if (token.type == TokenType::IDENTIFIER) {
-            std::string identifier = token.value;
-            // Check if it's a function call
-            if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "(") {
-                currentToken = lexer.nextToken();
-                std::vector<Ref<ASTNode>> args;
-                if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                    do {
-                        args.push_back(parseExpression());
-                        if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ")") {
-                            break;
-                        }
-                        if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ",") {
-                            throw ParseError("Expected ',' or ')' in function call", 
-                                           currentToken.line, currentToken.column);
-                        }
-                        currentToken = lexer.nextToken();
-                    } while (true);
+        switch (token.type) {
+            case TokenType::LPAREN: {
+                ASTNode* expr = parseExpression();
+                if (!check(TokenType::RPAREN)) {
+                    throw lexer.error("Expected closing parenthesis", currentToken.offset);
                 }
-                currentToken = lexer.nextToken();
-                return interpreter.createObject<FunctionCallNode>(identifier, args, &interpreter);
+                advance();
+                return expr;
             }
-            Ref<ASTNode> node = interpreter.createObject<IdentifierNode>(identifier);
-            
-            // Check for array access
-            while (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "[") {
-                currentToken = lexer.nextToken();
-                Ref<ASTNode> index = parseExpression();
-                
-                if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "]") {
-                    throw ParseError("Expected ']' after array index", 
-                                   currentToken.line, currentToken.column);
-                }
-                currentToken = lexer.nextToken();
-                
-                // Create ArrayAccessNode with the same base node
-                node = interpreter.createObject<ArrayAccessNode>(node, index);
+            case TokenType::LBRACKET: {
+                // Array literal
+                std::vector<ASTNode*> elements;
+                parseList(TokenType::RBRACKET, "Expected ',' or ']' in array literal", elements);
+                return make<ArrayNode>(std::move(elements), interpreter.getGC().getObjectPool());
             }
-            
-            // Check for property access (e.g., array.length)
-            if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ".") {
-                currentToken = lexer.nextToken();
-                
-                if (currentToken.type != TokenType::IDENTIFIER) {
-                    throw ParseError("Expected property name after '.'", 
-                                   currentToken.line, currentToken.column);
+            case TokenType::NUMBER: {
+                if (token.text.find('.') != std::string_view::npos) {
+                    // Number literals are integers: the fraction is dropped
+                    return make<NumberNode>(static_cast<int64_t>(std::stod(std::string(token.text))));
                 }
-                
-                std::string property = currentToken.value;
-                currentToken = lexer.nextToken();
-                
-                if (property == "length") {
-                    return interpreter.createObject<PropertyAccessNode>(node, property);
-                } else {
-                    throw ParseError("Unknown property: " + property, 
-                                   currentToken.line, currentToken.column);
+                int64_t value = 0;
+                auto result = std::from_chars(token.text.data(), token.text.data() + token.text.size(), value);
+                if (result.ec != std::errc()) {
+                    throw lexer.error("Integer literal out of range: " + std::string(token.text), token.offset);
                 }
+                return make<NumberNode>(value);
             }
-            
-            return node;
+            case TokenType::STRING:
+                return make<StringNode>(std::string(token.text));
+            case TokenType::KW_TRUE:
+                return make<BooleanNode>(true);
+            case TokenType::KW_FALSE:
+                return make<BooleanNode>(false);
+            case TokenType::IDENTIFIER: {
+                std::string identifier(token.text);
+                // Check if it's a function call
+                if (check(TokenType::LPAREN)) {
+                    advance();
+                    std::vector<ASTNode*> args;
+                    parseList(TokenType::RPAREN, "Expected ',' or ')' in function call", args);
+                    return make<FunctionCallNode>(std::move(identifier), std::move(args), &interpreter);
+                }
+                return make<IdentifierNode>(identifier);
+            }
+            default:
+                break;
         }
         
-        throw ParseError("Unexpected token: " + token.value, 
-                        token.line, token.column);
+        throw lexer.error("Unexpected token: " + std::string(token.text), token.offset);
     }
 };
 
-Ref<ASTNode> Parser::parseStatement() {
-    if (currentToken.type == TokenType::KEYWORD) {
-        if (currentToken.value == "print") {
-            currentToken = lexer.nextToken(); // Skip 'print'
-            Ref<ASTNode> expr;
-            // Handle both print expr; and print(expr);
-            if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "(") {
-                currentToken = lexer.nextToken();
-                expr = parseExpression();
-                if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                    throw ParseError("Expected ')' after print(", currentToken.line, currentToken.column);
-                }
-                currentToken = lexer.nextToken();
-            } else {
-                expr = parseExpression();
-            }
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ";") {
-                throw ParseError("Expected semicolon after print statement", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            return interpreter.createObject<PrintNode>(expr);
-        }
-        else if (currentToken.value == "if") {
-            currentToken = lexer.nextToken(); // Skip 'if'
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "(") {
-                throw ParseError("Expected '(' after if", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> condition = parseExpression();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                throw ParseError("Expected ')' after if condition", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "{") {
-                throw ParseError("Expected '{' after if condition", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<BlockNode> thenBlock = interpreter.createObject<BlockNode>(&interpreter.getGC());
-            while (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "}") {
-                thenBlock->addStatement(parseStatement());
-            }
-            currentToken = lexer.nextToken();
-            Ref<BlockNode> elseBlock;
-            if (currentToken.type == TokenType::KEYWORD && currentToken.value == "else") {
-                currentToken = lexer.nextToken();
-                if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "{") {
-                    throw ParseError("Expected '{' after else", currentToken.line, currentToken.column);
-                }
-                currentToken = lexer.nextToken();
-                elseBlock = interpreter.createObject<BlockNode>(&interpreter.getGC());
-                while (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "}") {
-                    elseBlock->addStatement(parseStatement());
-                }
-                currentToken = lexer.nextToken();
+ASTNode* Parser::parseStatement() {
+    if (check(TokenType::KW_PRINT)) {
+        advance(); // Skip 'print'
+        ASTNode* expr = nullptr;
+        // Handle both print expr; and print(expr);
+        if (check(TokenType::LPAREN)) {
+            advance();
+            expr = parseExpression();
+            if (!check(TokenType::RPAREN)) {
+                throw lexer.error("Expected ')' after print(", currentToken.offset);
             }
-            return interpreter.createObject<IfNode>(condition, thenBlock, elseBlock);
+            advance();
+        } else {
+            expr = parseExpression();
         }
-        else if (currentToken.value == "while") {
-            currentToken = lexer.nextToken(); // Skip 'while'
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "(") {
-                throw ParseError("Expected '(' after while", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> condition = parseExpression();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                throw ParseError("Expected ')' after while condition", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "{") {
-                throw ParseError("Expected '{' after while condition", currentToken.line, currentToken.column);
+        if (!check(TokenType::SEMICOLON)) {
+            throw lexer.error("Expected semicolon after print statement", currentToken.offset);
+        }
+        advance();
+        return make<PrintNode>(expr, &interpreter);
+    }
+    else if (check(TokenType::KW_IF)) {
+        advance(); // Skip 'if'
+        if (!check(TokenType::LPAREN)) {
+            throw lexer.error("Expected '(' after if", currentToken.offset);
+        }
+        advance();
+        ASTNode* condition = parseExpression();
+        if (!check(TokenType::RPAREN)) {
+            throw lexer.error("Expected ')' after if condition", currentToken.offset);
+        }
+        advance();
+        if (!check(TokenType::LBRACE)) {
+            throw lexer.error("Expected '{' after if condition", currentToken.offset);
+        }
+        advance();
+        BlockNode* thenBlock = make<BlockNode>();
+        while (!check(TokenType::RBRACE)) {
+            thenBlock->addStatement(parseStatement());
+        }
+        advance();
+        BlockNode* elseBlock = nullptr;
+        if (check(TokenType::KW_ELSE)) {
+            advance();
+            if (!check(TokenType::LBRACE)) {
+                throw lexer.error("Expected '{' after else", currentToken.offset);
             }
-            currentToken = lexer.nextToken();
-            Ref<BlockNode> body = interpreter.createObject<BlockNode>(&interpreter.getGC());
-            while (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "}") {
-                body->addStatement(parseStatement());
+            advance();
+            elseBlock = make<BlockNode>();
+            while (!check(TokenType::RBRACE)) {
+                elseBlock->addStatement(parseStatement());
             }
-            currentToken = lexer.nextToken();
-            return interpreter.createObject<WhileNode>(condition, body);
-        }
-        else if (currentToken.value == "for") {
-            currentToken = lexer.nextToken(); // Skip 'for'
-            if (currentToken.type != TokenType::IDENTIFIER) {
-                throw ParseError("Expected identifier after 'for'", currentToken.line, currentToken.column);
-            }
-            std::string varName = currentToken.value;
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::OPERATOR || currentToken.value != "=") {
-                throw ParseError("Expected '=' in for loop", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> start = parseExpression();
-            if (currentToken.type != TokenType::KEYWORD || currentToken.value != "to") {
-                throw ParseError("Expected 'to' in for loop", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> end = parseExpression();
-            Ref<ASTNode> step;
-            if (currentToken.type == TokenType::KEYWORD && currentToken.value == "step") {
-                currentToken = lexer.nextToken();
-                step = parseExpression();
-            } else {
-                step = interpreter.createObject<NumberNode>(1);
+            advance();
+        }
+        return make<IfNode>(condition, thenBlock, elseBlock);
+    }
+    else if (check(TokenType::KW_WHILE)) {
+        advance(); // Skip 'while'
+        if (!check(TokenType::LPAREN)) {
+            throw lexer.error("Expected '(' after while", currentToken.offset);
+        }
+        advance();
+        ASTNode* condition = parseExpression();
+        if (!check(TokenType::RPAREN)) {
+            throw lexer.error("Expected ')' after while condition", currentToken.offset);
+        }
+        advance();
+        if (!check(TokenType::LBRACE)) {
+            throw lexer.error("Expected '{' after while condition", currentToken.offset);
+        }
+        advance();
+        BlockNode* body = make<BlockNode>();
+        while (!check(TokenType::RBRACE)) {
+            body->addStatement(parseStatement());
+        }
+        advance();
+        return make<WhileNode>(condition, body);
+    }
+    else if (check(TokenType::KW_FOR)) {
+        advance(); // Skip 'for'
+        if (!check(TokenType::IDENTIFIER)) {
+            throw lexer.error("Expected identifier after 'for'", currentToken.offset);
+        }
+        std::string varName = currentText();
+        advance();
+        // Handle smart loop (for i, x in iterable)
+        if (check(TokenType::COMMA)) {
+            advance();
+            if (!check(TokenType::IDENTIFIER)) {
+                throw lexer.error("Expected second identifier in smart loop", currentToken.offset);
             }
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "{") {
-                throw ParseError("Expected '{' after for loop header", currentToken.line, currentToken.column);
+            std::string valueName = currentText();
+            advance();
+            if (!check(TokenType::KW_IN)) {
+                throw lexer.error("Expected 'in' in smart loop", currentToken.offset);
             }
-            currentToken = lexer.nextToken();
-            Ref<BlockNode> body = interpreter.createObject<BlockNode>(&interpreter.getGC());
-            while (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "}") {
-                body->addStatement(parseStatement());
+            advance();
+            ASTNode* iterable = parseExpression();
+            if (!check(TokenType::LBRACE)) {
+                throw lexer.error("Expected '{' after smart loop header", currentToken.offset);
             }
-            currentToken = lexer.nextToken();
-            return interpreter.createObject<ForNode>(varName, start, end, step, body);
-        }
-        else if (currentToken.value == "function") {
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::IDENTIFIER) {
-                throw ParseError("Expected function name after 'function'", currentToken.line, currentToken.column);
-            }
-            std::string funcName = currentToken.value;
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "(") {
-                throw ParseError("Expected '(' after function name", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            std::vector<std::string> params;
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                do {
-                    if (currentToken.type != TokenType::IDENTIFIER) {
-                        throw ParseError("Expected parameter name in function definition", currentToken.line, currentToken.column);
-                    }
-                    params.push_back(currentToken.value);
-                    currentToken = lexer.nextToken();
-                    if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ")") {
-                        break;
-                    }
-                    if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ",") {
-                        throw ParseError("Expected ',' or ')' in parameter list", currentToken.line, currentToken.column);
-                    }
-                    currentToken = lexer.nextToken();
-                } while (true);
-            }
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "{") {
-                throw ParseError("Expected '{' to start function body", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<BlockNode> body = interpreter.createObject<BlockNode>(&interpreter.getGC());
-            while (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "}") {
+            advance();
+            BlockNode* body = make<BlockNode>();
+            while (!check(TokenType::RBRACE)) {
                 body->addStatement(parseStatement());
             }
-            currentToken = lexer.nextToken();
-            interpreter.getGlobalScope()->set(funcName, Value(interpreter.createObject<UserFunctionNode>(funcName, params, body, &interpreter)));
-            return interpreter.createObject<BlockNode>(&interpreter.getGC()); // Placeholder node
+            advance();
+            return make<SmartLoopNode>(valueName, varName, iterable, body);
         }
-        else if (currentToken.value == "return") {
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> expr = parseExpression();
-            if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ";") {
-                currentToken = lexer.nextToken();
-            }
-            return interpreter.createObject<ReturnNode>(expr);
+        if (!check(TokenType::ASSIGN)) {
+            throw lexer.error("Expected '=' in for loop", currentToken.offset);
+        }
+        advance();
+        ASTNode* start = parseExpression();
+        if (!check(TokenType::KW_TO)) {
+            throw lexer.error("Expected 'to' in for loop", currentToken.offset);
+        }
+        advance();
+        ASTNode* end = parseExpression();
+        ASTNode* step = nullptr;
+        if (check(TokenType::KW_STEP)) {
+            advance();
+            step = parseExpression();
+        } else {
+            step = make<NumberNode>(1);
+        }
+        if (!check(TokenType::LBRACE)) {
+            throw lexer.error("Expected '{' after for loop header", currentToken.offset);
+        }
+        advance();
+        BlockNode* body = make<BlockNode>();
+        while (!check(TokenType::RBRACE)) {
+            body->addStatement(parseStatement());
+        }
+        advance();
+        return make<ForNode>(varName, start, end, step, body);
+    }
+    else if (check(TokenType::KW_FUNCTION)) {
+        advance();
+        if (!check(TokenType::IDENTIFIER)) {
+            throw lexer.error("Expected function name after 'function'", currentToken.offset);
+        }
+        std::string funcName = currentText();
+        advance();
+        if (!check(TokenType::LPAREN)) {
+            throw lexer.error("Expected '(' after function name", currentToken.offset);
+        }
+        advance();
+        std::vector<std::string> params;
+        if (!check(TokenType::RPAREN)) {
+            do {
+                if (!check(TokenType::IDENTIFIER)) {
+                    throw lexer.error("Expected parameter name in function definition", currentToken.offset);
+                }
+                params.push_back(currentText());
+                advance();
+                if (check(TokenType::RPAREN)) {
+                    break;
+                }
+                if (!check(TokenType::COMMA)) {
+                    throw lexer.error("Expected ',' or ')' in parameter list", currentToken.offset);
+                }
+                advance();
+            } while (true);
+        }
+        advance();
+        if (!check(TokenType::LBRACE)) {
+            throw lexer.error("Expected '{' to start function body", currentToken.offset);
         }
+        // Only the extent of the body is found now; it is parsed on the first call
+        size_t bodyStart = currentToken.offset;
+        lexer.skipBlock();
+        advance();
+        // Functions are registered before the program runs, so the definition itself is no statement
+        functions.push_back(make<UserFunctionNode>(funcName, params, &program, bodyStart, &interpreter));
+        return nullptr;
     }
-    else if (currentToken.type == TokenType::IDENTIFIER) {
-        if (currentToken.value.empty()) {
-            throw ParseError("Empty identifier token encountered (possible lexer bug or malformed input)", currentToken.line, currentToken.column);
+    else if (check(TokenType::KW_RETURN)) {
+        advance();
+        ASTNode* expr = nullptr;
+        if (!check(TokenType::SEMICOLON) && !check(TokenType::RBRACE)) {
+            expr = parseExpression();
+        }
+        if (check(TokenType::SEMICOLON)) {
+            advance();
+        }
+        return make<ReturnNode>(expr);
+    }
+    else if (check(TokenType::IDENTIFIER)) {
+        if (currentToken.text.empty()) {
+            throw lexer.error("Empty identifier token encountered (possible lexer bug or malformed input)", currentToken.offset);
+        }
+        std::string name = currentText();
+        advance();
+        // 'parallel' is only a keyword in front of 'for'
+        if (name == "parallel" && check(TokenType::KW_FOR)) {
+            return parseParallelFor();
         }
-        std::string name = currentToken.value;
-        currentToken = lexer.nextToken();
         // Handle debug_gc() function
-        if (name == "debug_gc" && currentToken.type == TokenType::PUNCTUATION && currentToken.value == "(") {
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                throw ParseError("Expected ')' after debug_gc(", currentToken.line, currentToken.column);
+        if (name == "debug_gc" && check(TokenType::LPAREN)) {
+            advance();
+            if (!check(TokenType::RPAREN)) {
+                throw lexer.error("Expected ')' after debug_gc(", currentToken.offset);
             }
-            currentToken = lexer.nextToken();
-            if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ";") {
-                currentToken = lexer.nextToken();
+            advance();
+            if (check(TokenType::SEMICOLON)) {
+                advance();
             }
             // Create a node that will print GC stats with access to the GC
-            return interpreter.createObject<DebugGCNode>(&interpreter.getGC());
+            return make<DebugGCNode>(&interpreter.getGC());
         }
         // Handle clean_gc() function
-        if (name == "clean_gc" && currentToken.type == TokenType::PUNCTUATION && currentToken.value == "(") {
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                throw ParseError("Expected ')' after clean_gc(", currentToken.line, currentToken.column);
+        if (name == "clean_gc" && check(TokenType::LPAREN)) {
+            advance();
+            if (!check(TokenType::RPAREN)) {
+                throw lexer.error("Expected ')' after clean_gc(", currentToken.offset);
             }
-            currentToken = lexer.nextToken();
-            if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ";") {
-                currentToken = lexer.nextToken();
+            advance();
+            if (check(TokenType::SEMICOLON)) {
+                advance();
             }
             // Create a node that will force garbage collection
-            return interpreter.createObject<CleanGCNode>(&interpreter.getGC());
+            return make<CleanGCNode>(&interpreter.getGC());
         }
         // Handle array access assignments like: array[index] = value;
-        if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "[") {
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> index = parseExpression();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "]") {
-                throw ParseError("Expected ']' after array index", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            if (currentToken.type == TokenType::OPERATOR && currentToken.value == "=") {
-                currentToken = lexer.nextToken();
-                Ref<ASTNode> value = parseExpression();
-                if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ";") {
-                    currentToken = lexer.nextToken();
+        ASTNode* subject = nullptr;
+        if (check(TokenType::LBRACKET)) {
+            advance();
+            ASTNode* index = parseExpression();
+            if (!check(TokenType::RBRACKET)) {
+                throw lexer.error("Expected ']' after array index", currentToken.offset);
+            }
+            advance();
+            if (check(TokenType::ASSIGN)) {
+                advance();
+                ASTNode* value = parseExpression();
+                if (check(TokenType::SEMICOLON)) {
+                    advance();
                 }
-                return interpreter.createObject<ArrayAssignmentNode>(
-                    interpreter.createObject<IdentifierNode>(name),
+                return make<ArrayAssignmentNode>(
+                    make<IdentifierNode>(name),
                     index,
-                    value,
-                    &interpreter
+                    value
                 );
             }
+            subject = make<ArrayAccessNode>(make<IdentifierNode>(name), index);
         }
         std::string type;
-        if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ":") {
-            currentToken = lexer.nextToken();
+        if (check(TokenType::COLON)) {
+            advance();
             // Accept type tokens and any following [] as part of the type
-            if (currentToken.type != TokenType::TYPE && currentToken.type != TokenType::IDENTIFIER) {
-                throw ParseError("Expected type after ':' in variable declaration", currentToken.line, currentToken.column);
+            if (!check(TokenType::TYPE) && !check(TokenType::IDENTIFIER)) {
+                throw lexer.error("Expected type after ':' in variable declaration", currentToken.offset);
             }
-            type = currentToken.value;
-            currentToken = lexer.nextToken();
+            type = currentText();
+            advance();
             // Collect any [] as part of the type annotation
-            while (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "[") {
+            while (check(TokenType::LBRACKET)) {
                 type += "[";
-                currentToken = lexer.nextToken();
-                if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "]") {
-                    throw ParseError("Expected ']' in array type annotation", currentToken.line, currentToken.column);
+                advance();
+                if (!check(TokenType::RBRACKET)) {
+                    throw lexer.error("Expected ']' in array type annotation", currentToken.offset);
                 }
                 type += "]";
-                currentToken = lexer.nextToken();
+                advance();
             }
         }
-        if (currentToken.type == TokenType::OPERATOR && currentToken.value == "=") {
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> expr = parseExpression();
+        if (check(TokenType::ASSIGN)) {
+            advance();
+            ASTNode* expr = parseExpression();
             // Make semicolon optional
-            if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ";") {
-                currentToken = lexer.nextToken();
-            }
-            return interpreter.createObject<AssignmentNode>(name, expr, type);
-        }
-        else if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == "(") {
-            currentToken = lexer.nextToken();
-            std::vector<Ref<ASTNode>> arguments;
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ")") {
-                do {
-                    arguments.push_back(parseExpression());
-                    if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ")") {
-                        break;
-                    }
-                    if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ",") {
-                        throw ParseError("Expected ',' or ')' in function call", currentToken.line, currentToken.column);
-                    }
-                    currentToken = lexer.nextToken();
-                } while (true);
-            }
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != ";") {
-                throw ParseError("Expected semicolon after function call", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            return interpreter.createObject<FunctionCallNode>(name, arguments, &interpreter);
+            if (check(TokenType::SEMICOLON)) {
+                advance();
+            }
+            return make<AssignmentNode>(name, expr, type);
+        }
+        else if (check(TokenType::LPAREN)) {
+            advance();
+            std::vector<ASTNode*> arguments;
+            parseList(TokenType::RPAREN, "Expected ',' or ')' in function call", arguments);
+            if (!check(TokenType::SEMICOLON)) {
+                throw lexer.error("Expected semicolon after function call", currentToken.offset);
+            }
+            advance();
+            return make<FunctionCallNode>(std::move(name), std::move(arguments), &interpreter);
         }
         // Handle smart loop (for i, x in array)
-        else if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ",") {
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::IDENTIFIER) {
-                throw ParseError("Expected second identifier in smart loop", currentToken.line, currentToken.column);
-            }
-            std::string valueName = currentToken.value;
-            currentToken = lexer.nextToken();
-            if (currentToken.type != TokenType::KEYWORD || currentToken.value != "in") {
-                throw ParseError("Expected 'in' in smart loop", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<ASTNode> array = parseExpression();
-            if (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "{") {
-                throw ParseError("Expected '{' after smart loop header", currentToken.line, currentToken.column);
-            }
-            currentToken = lexer.nextToken();
-            Ref<BlockNode> body = interpreter.createObject<BlockNode>(&interpreter.getGC());
-            while (currentToken.type != TokenType::PUNCTUATION || currentToken.value != "}") {
+        else if (check(TokenType::COMMA)) {
+            advance();
+            if (!check(TokenType::IDENTIFIER)) {
+                throw lexer.error("Expected second identifier in smart loop", currentToken.offset);
+            }
+            std::string valueName = currentText();
+            advance();
+            if (!check(TokenType::KW_IN)) {
+                throw lexer.error("Expected 'in' in smart loop", currentToken.offset);
+            }
+            advance();
+            ASTNode* array = parseExpression();
+            if (!check(TokenType::LBRACE)) {
+                throw lexer.error("Expected '{' after smart loop header", currentToken.offset);
+            }
+            advance();
+            BlockNode* body = make<BlockNode>();
+            while (!check(TokenType::RBRACE)) {
                 body->addStatement(parseStatement());
             }
-            currentToken = lexer.nextToken();
-            return interpreter.createObject<SmartLoopNode>(valueName, name, array, body);
+            advance();
+            return make<SmartLoopNode>(valueName, name, array, body);
+        }
+        // Anything else is an expression statement that starts with the name
+        ASTNode* expr = parseInfix(parsePostfix(subject ? subject : make<IdentifierNode>(name)), PREC_OR);
+        if (check(TokenType::SEMICOLON)) {
+            advance();
         }
+        return expr;
     }
-    Ref<ASTNode> expr = parseExpression();
-    if (currentToken.type == TokenType::PUNCTUATION && currentToken.value == ";") {
-        currentToken = lexer.nextToken();
+    ASTNode* expr = parseExpression();
+    if (check(TokenType::SEMICOLON)) {
+        advance();
     }
     return expr;
 }
 
-void JeveInterpreter::interpret(const std::string& code) {
+void Parser::parseProgram() {
+    while (!isEOF()) {
+        if (ASTNode* stmt = parseStatement()) {
+            program.addStatement(stmt);
+        }
+    }
+    for (UserFunctionNode* function : functions) {
+        program.addFunction(function);
+    }
+}
+
+BlockNode* Parser::parseFunctionBody() {
+    if (!check(TokenType::LBRACE)) {
+        throw lexer.error("Expected '{' to start function body", currentToken.offset);
+    }
+    advance();
+    BlockNode* body = make<BlockNode>();
+    while (!check(TokenType::RBRACE)) {
+        body->addStatement(parseStatement());
+    }
+    return body;
+}
+
+std::unique_ptr<Program> JeveInterpreter::parse(std::string code) {
+    auto program = std::make_unique<Program>(std::move(code));
+    Parser parser(program->getSource(), *this, *program, program->getArena());
+    parser.parseProgram();
+    return program;
+}
+
+std::unique_ptr<Program> JeveInterpreter::compile(std::string code, const std::string& cachePath) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t key = ProgramCache::key(code);
+    if (auto cached = ProgramCache::load(cachePath, key, *this)) {
+        if (isDebug()) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            *output << "[Jeve] Loaded compiled script from " << cachePath << " in " << ms << " ms" << std::endl;
+        }
+        return cached;
+    }
+    auto program = parse(std::move(code));
+    try {
+        compileFunctions(*program);
+    } catch (const ParseError&) {
+        // The error surfaces when that function is called; such scripts are not cached
+        return program;
+    }
+    if (!ProgramCache::save(*program, cachePath, key) && isDebug()) {
+        *output << "[Jeve] Could not write script cache " << cachePath << std::endl;
+    }
+    return program;
+}
+
+void JeveInterpreter::defineFunctions(Program& program, const std::vector<UserFunctionNode*>& functions) {
+    for (UserFunctionNode* function : functions) {
+        program.addFunction(function);
+        globalScope->set(function->getName(), Value(Ref<Object>(function)));
+    }
+}
+
+BlockNode* JeveInterpreter::parseFunctionBody(Program& program, size_t start) {
+    // Bodies of different functions may be parsed from several threads at once
+    std::lock_guard<std::mutex> lock(program.getParseMutex());
+    if (BodyDecoder* decoder = program.getBodyDecoder()) {
+        return decoder->decode(start);
+    }
+    Parser parser(program.getSource(), *this, program, program.getArena(), start);
+    BlockNode* body = parser.parseFunctionBody();
+    // Functions defined inside the body become visible once it has been parsed
+    defineFunctions(program, parser.getFunctions());
+    return body;
+}
+
+void JeveInterpreter::compileFunctions(Program& program) {
+    // Callers compile before the program runs, so no body is being parsed lazily
+    std::lock_guard<std::mutex> lock(program.getParseMutex());
+
+    if (BodyDecoder* decoder = program.getBodyDecoder()) {
+        // Decoded bodies are cheap to build and never define functions
+        for (UserFunctionNode* function : program.getFunctions()) {
+            if (!function->isParsed()) function->setBody(decoder->decode(function->getBodyStart()));
+        }
+        return;
+    }
+
+    struct Compiled {
+        BlockNode* body = nullptr;
+        std::vector<UserFunctionNode*> functions;
+        std::exception_ptr error;
+    };
+
+    // Each round compiles the functions found so far; bodies can define more
+    size_t begin = 0;
+    while (begin < program.getFunctions().size()) {
+        std::vector<UserFunctionNode*> pending;
+        for (size_t i = begin; i < program.getFunctions().size(); ++i) {
+            if (!program.getFunctions()[i]->isParsed()) pending.push_back(program.getFunctions()[i]);
+        }
+        begin = program.getFunctions().size();
+        std::vector<Compiled> results(pending.size());
+
+        auto compileRange = [&](size_t first, size_t last, Arena& arena) {
+            for (size_t i = first; i < last; ++i) {
+                try {
+                    Parser parser(program.getSource(), *this, program, arena, pending[i]->getBodyStart());
+                    results[i].body = parser.parseFunctionBody();
+                    results[i].functions = std::move(parser.getFunctions());
+                } catch (...) {
+                    results[i].error = std::current_exception();
+                }
+            }
+        };
+
+        if (parallelCompileThreshold > 0 && pending.size() >= parallelCompileThreshold) {
+            // Several batches per thread balance uneven body sizes; each batch
+            // gets an arena of its own that the program then takes over
+            ThreadPool& pool = getThreadPool();
+            size_t batches = std::min(pending.size(), pool.size() * 4);
+            std::vector<std::unique_ptr<Arena>> arenas(batches);
+            for (auto& arena : arenas) arena = std::make_unique<Arena>();
+            pool.parallelFor(batches, [&](size_t batch) {
+                compileRange(pending.size() * batch / batches, pending.size() * (batch + 1) / batches, *arenas[batch]);
+            });
+            for (auto& arena : arenas) program.adoptArena(std::move(arena));
+        } else {
+            compileRange(0, pending.size(), program.getArena());
+        }
+
+        // Merge in definition order, so the function table and the first
+        // error reported match a serial compile
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (results[i].error) std::rethrow_exception(results[i].error);
+            pending[i]->setBody(results[i].body);
+            defineFunctions(program, results[i].functions);
+        }
+    }
+}
+
+void JeveInterpreter::parseAllFunctions() {
+    if (parsedPrograms == programs.size()) return;
+    for (const auto& program : programs) {
+        // By index: a body can define more functions
+        for (size_t i = 0; i < program->getFunctions().size(); ++i) {
+            UserFunctionNode* function = program->getFunctions()[i];
+            if (function->isParsed()) continue;
+            try {
+                function->getBody();
+            } catch (const std::exception&) {
+                // Thrown again when the function is called
+            }
+        }
+    }
+    parsedPrograms = programs.size();
+}
+
+void JeveInterpreter::runParallel(size_t count, const std::function<void(size_t, size_t, size_t)>& body) {
+    ThreadPool& pool = getThreadPool();
+    // Small chunks keep the workers balanced; stealing makes them cheap
+    size_t grain = std::max<size_t>(1, count / (pool.size() * 32));
+    if (AllocationBuffer::current()) {
+        pool.parallelRange(count, grain, body);
+        return;
+    }
+
+    // Lazy parsing defines functions in the global scope, which workers read
+    parseAllFunctions();
+    std::vector<AllocationBuffer> buffers(pool.size());
+    std::exception_ptr failure;
+    try {
+        pool.parallelRange(count, grain, [&](size_t worker, size_t begin, size_t end) {
+            AllocationBuffer::Use use(buffers[worker]);
+            body(worker, begin, end);
+        });
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    gc.adopt(buffers);
+    if (failure) std::rethrow_exception(failure);
+}
+
+void JeveInterpreter::runAsWorker(size_t count, const std::function<void(size_t, size_t, size_t)>& body) {
+    if (AllocationBuffer::current()) {
+        body(0, 0, count);
+        return;
+    }
+    std::vector<AllocationBuffer> buffers(1);
+    std::exception_ptr failure;
+    try {
+        AllocationBuffer::Use use(buffers[0]);
+        body(0, 0, count);
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    gc.adopt(buffers);
+    if (failure) std::rethrow_exception(failure);
+}
+
+Value JeveInterpreter::execute(Program& program) {
+    // The script's safepoints serve this interpreter's collector
+    Safepoint::Use safepoints(gc);
+    for (UserFunctionNode* function : program.getFunctions()) {
+        globalScope->set(function->getName(), Value(Ref<Object>(function)));
+    }
+    try {
+        for (ASTNode* stmt : program.getStatements()) {
+            stmt->evaluate(*globalScope);
+        }
+    } catch (const ReturnException& e) {
+        // A top-level return ends the script
+        return e.getValue();
+    }
+    return Value();
+}
+
+Program& JeveInterpreter::load(std::string code, const std::string& cachePath) {
+    // The program must outlive any function values it defines, so the interpreter keeps it
+    programs.push_back(cachePath.empty() ? parse(std::move(code)) : compile(std::move(code), cachePath));
+    if (eagerCompile) {
+        compileFunctions(*programs.back());
+    }
+    return *programs.back();
+}
+
+void JeveInterpreter::interpret(std::string code, const std::string& cachePath) {
     try {
-        Parser parser(code, *this);
-        while (!parser.isEOF()) {
-            Ref<ASTNode> stmt = parser.parseStatement();
-            if (stmt) stmt->evaluate(*globalScope);
+        execute(load(std::move(code), cachePath));
+        // Pauses while the script ran; the final collection is not one
+        if (gcStats) {
+            gc.printPauses(*errorOutput);
+            gc.getObjectPool()->printSlabStats(*errorOutput);
         }
 
         // Perform final cleanup and output memory stats
@@ -777,14 +1176,14 @@ void JeveInterpreter::interpret(const std::string& code) {
         //     gc.getObjectPool()->printStats();
         // }
     } catch (const ParseError& e) {
-        std::cerr << "[CATCH] ParseError: " << e.what() << std::endl;
-        std::cerr << e.getFormattedMessage() << std::endl;
-        std::cout << std::flush;
+        *errorOutput << "[CATCH] ParseError: " << e.what() << std::endl;
+        *errorOutput << e.getFormattedMessage() << std::endl;
+        output->flush();
         throw std::runtime_error(e.getFormattedMessage());
     } catch (const std::exception& e) {
-        std::cerr << "[CATCH] std::exception: " << e.what() << std::endl;
-        std::cerr << "Interpreter error: " << e.what() << std::endl;
-        std::cout << std::flush;
+        *errorOutput << "[CATCH] std::exception: " << e.what() << std::endl;
+        *errorOutput << "Interpreter error: " << e.what() << std::endl;
+        output->flush();
         throw std::runtime_error(std::string("Interpreter error: ") + e.what());
     }
 }
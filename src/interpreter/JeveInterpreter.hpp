@@ -6,41 +6,219 @@
 #include "Object.hpp"
 #include "SymbolTable.hpp"
 #include "GarbageCollector.hpp"
+#include "ThreadPool.hpp"
+#include "Program.hpp"
 #include <stack>
 #include <string>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
 
 namespace jeve {
 
+class ParseError : public std::runtime_error {
+private:
+    size_t line;
+    size_t column;
+
+public:
+    ParseError(const std::string& message, size_t l, size_t c)
+        : std::runtime_error(message), line(l), column(c) {}
+
+    std::string getFormattedMessage() const {
+        std::ostringstream oss;
+        oss << "Error at line " << line << ", column " << column << ": " << what();
+        return oss.str();
+    }
+};
+
+// Settings fixed when an interpreter is created
+struct InterpreterOptions {
+    size_t initialHeap = 1 * 1024 * 1024;
+    size_t maxHeap = 64 * 1024 * 1024;
+    bool debug = false;                      // trace the GC and allocations on stdout
+    std::string memoryLog;                   // CSV of heap usage per allocation; empty disables it
+    bool incrementalGC = false;              // run major collections in slices between allocations
+    bool concurrentGC = false;               // mark on a background thread, sweep in slices
+    size_t gcSliceMicros = 500;              // longest slice of an incremental collection
+    bool gcStats = false;                    // report GC pause times when the script ends
+    size_t gcThreads = 0;                    // threads that mark a large collection; 0 uses every core
+    bool hugePages = false;                  // back the heap with transparent huge pages
+    size_t parallelSortThreshold = 1 << 16;  // 0 disables parallel sorting
+    size_t parallelCompileThreshold = 64;    // 0 disables parallel compilation
+    size_t parallelMapThreshold = 1024;      // 0 keeps map/filter/reduce on one thread
+    bool eagerCompile = false;               // parse every function body before running
+    size_t threads = 0;                      // for parallel loops, sorts and compiles; 0 uses every core
+    std::ostream* output = &std::cout;       // print() writes here
+    std::ostream* errorOutput = &std::cerr;  // runtime errors from interpret()
+    std::istream* input = &std::cin;         // input() reads from here
+};
+
+// One interpreter holds all of its state: heap, globals, loaded programs and
+// I/O streams. Separate instances share nothing, so each can run on a thread
+// of its own; a single instance must only be used by one thread at a time.
 class JeveInterpreter {
 private:
     GarbageCollector gc;
+    std::vector<std::unique_ptr<Program>> programs;  // owns the AST of every interpreted script
     std::unique_ptr<SymbolTable> globalScope;
     std::stack<std::unique_ptr<SymbolTable>> scopeStack;
+    std::unique_ptr<ThreadPool> threadPool;    // created on first parallel builtin
+    size_t threadCount;
+    size_t parallelSortThreshold;
+    size_t parallelCompileThreshold;
+    size_t parallelMapThreshold;
+    bool eagerCompile;
+    std::ostream* output;
+    std::ostream* errorOutput;
+    std::istream* input;
+    std::mutex ioMutex;
+    size_t parsedPrograms = 0;  // programs whose functions parseAllFunctions() has seen
+    bool gcStats;
+
+    // Adds functions found inside a body to the program and the global scope
+    void defineFunctions(Program& program, const std::vector<UserFunctionNode*>& functions);
+
+    static InterpreterOptions heapOptions(size_t initialHeap, size_t maxHeap) {
+        InterpreterOptions options;
+        options.initialHeap = initialHeap;
+        options.maxHeap = maxHeap;
+        return options;
+    }
 
 public:
-    JeveInterpreter(size_t initialHeap = 1 * 1024 * 1024, size_t maxHeap = 64 * 1024 * 1024) 
-        : gc(initialHeap, maxHeap), globalScope(std::make_unique<SymbolTable>()) {
+    explicit JeveInterpreter(const InterpreterOptions& options = InterpreterOptions())
+        : gc(options.initialHeap, options.maxHeap, options.memoryLog),
+          globalScope(std::make_unique<SymbolTable>()),
+          threadCount(options.threads),
+          parallelSortThreshold(options.parallelSortThreshold),
+          parallelCompileThreshold(options.parallelCompileThreshold),
+          parallelMapThreshold(options.parallelMapThreshold),
+          eagerCompile(options.eagerCompile),
+          output(options.output),
+          errorOutput(options.errorOutput),
+          input(options.input),
+          gcStats(options.gcStats) {
         scopeStack.push(std::make_unique<SymbolTable>(globalScope.get()));
         gc.setInterpreter(this);
+        gc.setDebug(options.debug);
+        gc.setLog(*output);
+        gc.setMarkThreads(options.gcThreads);
+        gc.setHugePages(options.hugePages);
+        if (options.concurrentGC) {
+            gc.setConcurrent(options.gcSliceMicros);
+        } else if (options.incrementalGC) {
+            gc.setIncremental(options.gcSliceMicros);
+        }
     }
 
-    void interpret(const std::string& code);
+    JeveInterpreter(size_t initialHeap, size_t maxHeap)
+        : JeveInterpreter(heapOptions(initialHeap, maxHeap)) {}
+
+    // Parses and runs a script. With a cache path, a compiled copy of the
+    // script is loaded from it when current and written back otherwise.
+    void interpret(std::string code, const std::string& cachePath = std::string());
+
+    // Parses a whole script without running any of it. The program keeps the
+    // source buffer, which the lexer reads in place.
+    std::unique_ptr<Program> parse(std::string code);
+    // Like parse(), but goes through the compiled-script cache at cachePath
+    std::unique_ptr<Program> compile(std::string code, const std::string& cachePath);
+    // Parses the body of a function that was only skimmed by parse()
+    BlockNode* parseFunctionBody(Program& program, size_t start);
+    // Parses every body that has not been parsed yet, on all cores when the
+    // program has at least parallelCompileThreshold of them. The result is
+    // the same as calling each function's getBody() in definition order.
+    // Must be called before the program starts running.
+    void compileFunctions(Program& program);
+    // Parses every body not parsed yet in all programs, so that no function
+    // is defined while a parallel loop runs. Bodies with syntax errors stay
+    // unparsed and report the error when called, as they would anyway.
+    void parseAllFunctions();
+    // Runs body(worker, begin, end) over [0, count) on the thread pool with
+    // work stealing (see ThreadPool::parallelRange); worker is below
+    // getThreadPool().size(). Bodies are parsed first, and objects the
+    // workers create join the heap once all of them are done. Inside
+    // another parallel run this runs serially on the calling worker.
+    void runParallel(size_t count, const std::function<void(size_t worker, size_t begin, size_t end)>& body);
+    // Runs body(0, 0, count) on the calling thread as runParallel's only
+    // worker: containers from before the run are read-only to it, and what
+    // it creates joins the heap afterwards
+    void runAsWorker(size_t count, const std::function<void(size_t worker, size_t begin, size_t end)>& body);
+    // Registers the program's functions, then runs its top-level statements.
+    // Returns the value of a top-level return, or null.
+    Value execute(Program& program);
+
+    // Embedding API: load a script once, then execute it as often as needed.
+    // Globals persist between runs, so inputs are bound with setGlobal() and
+    // results read back with getGlobal() or returned from the top level.
+    // Errors are thrown (ParseError for syntax errors) and nothing is printed.
+
+    // Parses a script, through the compiled-script cache when a path is given.
+    // The interpreter owns the program until it is destroyed.
+    Program& load(std::string code, const std::string& cachePath = std::string());
+
+    Value getGlobal(const std::string& name) const { return globalScope->get(name); }
+    void setGlobal(const std::string& name, Value value) { globalScope->set(name, std::move(value)); }
+
+    // Programs run so far, oldest first
+    const std::vector<std::unique_ptr<Program>>& getPrograms() const { return programs; }
+    // Keeps a program built elsewhere (e.g. by a heap snapshot) alive as long
+    // as the interpreter, since values may point into its AST
+    void adoptProgram(std::unique_ptr<Program> program) { programs.push_back(std::move(program)); }
 
     template<typename T, typename... Args>
     Ref<T> createObject(Args&&... args) {
         // Create object only when needed during interpretation
         T* obj = gc.createObject<T>(std::forward<Args>(args)...);
-        if (g_jeve_debug) {
-            std::cout << "[DEBUG] Created object of type " << typeid(T).name() << std::endl;
+        if (gc.isDebug()) {
+            // Workers of a parallel loop allocate too
+            std::lock_guard<std::mutex> lock(ioMutex);
+            *output << "[DEBUG] Created object of type " << typeid(T).name() << std::endl;
         }
         return Ref<T>(obj);
     }
 
+    bool isDebug() const { return gc.isDebug(); }
+
+    std::ostream& getOutput() { return *output; }
+    std::ostream& getErrorOutput() { return *errorOutput; }
+    std::istream& getInput() { return *input; }
+    // Held while print() or input() use the streams, which workers of a
+    // parallel loop share
+    std::mutex& getIOMutex() { return ioMutex; }
+    // Redirects I/O, e.g. to hand an idle interpreter to a new client
+    void setStreams(std::ostream& out, std::ostream& err, std::istream& in) {
+        output = &out;
+        errorOutput = &err;
+        input = &in;
+        gc.setLog(out);
+    }
+
     GarbageCollector& getGC() { return gc; }
     SymbolTable& getCurrentScope() { return *scopeStack.top(); }
     SymbolTable* getGlobalScope() { return globalScope.get(); }
+
+    ThreadPool& getThreadPool() {
+        if (!threadPool) threadPool = std::make_unique<ThreadPool>(threadCount);
+        return *threadPool;
+    }
+
+    size_t getParallelSortThreshold() const { return parallelSortThreshold; }
+    void setParallelSortThreshold(size_t threshold) { parallelSortThreshold = threshold; }
+
+    size_t getParallelCompileThreshold() const { return parallelCompileThreshold; }
+    void setParallelCompileThreshold(size_t threshold) { parallelCompileThreshold = threshold; }
+
+    size_t getParallelMapThreshold() const { return parallelMapThreshold; }
+    void setParallelMapThreshold(size_t threshold) { parallelMapThreshold = threshold; }
+
+    bool isEagerCompile() const { return eagerCompile; }
+    void setEagerCompile(bool eager) { eagerCompile = eager; }
 };
 
 } // namespace jeve 
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace jeve {
+
+// Read-only view of a whole file; mapped where the platform allows it
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    std::string buffer;
+#else
+    void* mapping = nullptr;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path) {
+#if defined(_WIN32)
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        size = buffer.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                mapping = mapped;
+                data = static_cast<const char*>(mapped);
+                size = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#if !defined(_WIN32)
+        if (mapping) ::munmap(mapping, size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* getData() const { return data; }
+    size_t getSize() const { return size; }
+};
+
+} // namespace jeve
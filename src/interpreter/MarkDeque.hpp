@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jeve {
+
+class Object;
+
+// A gray object and the reference to go on tracing it from; a large
+// container is traced a chunk at a time
+struct MarkTask {
+    Object* obj = nullptr;
+    size_t offset = 0;
+};
+
+// Chase-Lev work-stealing deque of mark tasks. Its owner pushes and takes at
+// the bottom without locking; other markers steal from the top with one
+// compare-and-swap. The ring doubles when full. Outgrown rings are kept until
+// reset(), since a thief may still be reading one.
+class MarkDeque {
+private:
+    struct Ring {
+        size_t mask;
+        std::unique_ptr<std::atomic<Object*>[]> objects;
+        std::unique_ptr<std::atomic<size_t>[]> offsets;
+
+        explicit Ring(size_t capacity)
+            : mask(capacity - 1),
+              objects(new std::atomic<Object*>[capacity]),
+              offsets(new std::atomic<size_t>[capacity]) {}
+
+        size_t capacity() const { return mask + 1; }
+
+        void put(int64_t index, const MarkTask& task) {
+            objects[index & mask].store(task.obj, std::memory_order_relaxed);
+            offsets[index & mask].store(task.offset, std::memory_order_relaxed);
+        }
+
+        MarkTask get(int64_t index) const {
+            return {objects[index & mask].load(std::memory_order_relaxed),
+                    offsets[index & mask].load(std::memory_order_relaxed)};
+        }
+    };
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<Ring*> ring;
+    std::vector<std::unique_ptr<Ring>> rings;  // touched by the owner only
+
+    Ring* grow(Ring* old, int64_t from, int64_t to) {
+        rings.push_back(std::make_unique<Ring>(old->capacity() * 2));
+        Ring* bigger = rings.back().get();
+        for (int64_t i = from; i < to; ++i) bigger->put(i, old->get(i));
+        ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+public:
+    // capacity must be a power of two
+    explicit MarkDeque(size_t capacity = 1024) {
+        rings.push_back(std::make_unique<Ring>(capacity));
+        ring.store(rings.back().get(), std::memory_order_relaxed);
+    }
+
+    MarkDeque(const MarkDeque&) = delete;
+    MarkDeque& operator=(const MarkDeque&) = delete;
+
+    // Owner only
+    void push(const MarkTask& task) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Ring* r = ring.load(std::memory_order_relaxed);
+        if (b - t >= static_cast<int64_t>(r->capacity())) r = grow(r, t, b);
+        r->put(b, task);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only: the newest task
+    bool take(MarkTask& task) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring* r = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        task = r->get(b);
+        if (t < b) return true;
+        // The last task: thieves may be after it too
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    // Any thread: the oldest task. Fails when empty or when another thread
+    // took that task first.
+    bool steal(MarkTask& task) {
+        int64_t t = top.load(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b) return false;
+        Ring* r = ring.load(std::memory_order_acquire);
+        task = r->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Owner only, once no thread can steal: empties the deque and frees the
+    // outgrown rings
+    void reset() {
+        top.store(0, std::memory_order_relaxed);
+        bottom.store(0, std::memory_order_relaxed);
+        if (rings.size() > 1) {
+            std::unique_ptr<Ring> last = std::move(rings.back());
+            rings.clear();
+            rings.push_back(std::move(last));
+        }
+    }
+};
+
+} // namespace jeve
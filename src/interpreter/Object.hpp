@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Forward.hpp"
+#include "SlabAllocator.hpp"
 #include "ObjectPool.hpp"
 #include "GarbageCollector.hpp"
 #include <vector>
@@ -11,15 +12,12 @@
 #include <string>
 #include <cctype>
 #include <atomic>
+#include <cstdint>
 
 namespace jeve {
 
 // Forward declarations
 class Object;
-class ASTNode;
-class BinaryOpNode;
-class PrintNode;
-class StatementNode;
 
 // Utility function to parse memory size strings (e.g., "64m", "1g", "512k")
 inline size_t parseMemorySize(const std::string& sizeStr) {
@@ -47,10 +45,37 @@ inline size_t parseMemorySize(const std::string& sizeStr) {
     return value * multiplier;
 }
 
+// Receives each heap object another object refers to; see Object::trace
+class Visitor {
+public:
+    virtual ~Visitor() = default;
+    virtual void visit(Object* obj) = 0;
+};
+
 class Object {
+private:
+    // Collector list links and pool slot, owned by ObjectList and ObjectPool
+    Object* listPrev = nullptr;
+    Object* listNext = nullptr;
+    uint32_t poolSlot = NO_SLOT;
+    // Position in the collector's buffer of possible cycle roots
+    uint32_t candidateSlot = NO_SLOT;
+    uint8_t gcFlags = 0;
+    // Slab size class the object was allocated from, if any
+    uint8_t sizeClass = SlabAllocator::NO_CLASS;
+
+    friend class ObjectList;
+    friend class ObjectPool;
+    friend class AllocationBuffer;
+    friend class GarbageCollector;
+
 protected:
-    bool marked = false;
+    // Atomic so a concurrent marker can set it beside the script
+    std::atomic<bool> marked{false};
     std::atomic<int> refCount{0};  // Use atomic for thread safety
+    // References not accounted for by other traced objects, or UNTRACED
+    // outside a collection
+    int gcRefs = UNTRACED;
     ObjectPool* pool;
 
 public:
@@ -59,31 +84,147 @@ public:
 
     void incrementRefCount() {
         refCount++;
+        // Write barrier for incremental marking
+        if (pool && pool->isMarking()) pool->shade(this);
     }
     
     void decrementRefCount() {
-        if (refCount.fetch_sub(1) == 1) {
-            // Only delete if we were the last reference
-            if (pool) {
-                pool->release(this);
-            }
-            // Don't delete here - let the garbage collector handle it
-            // This prevents double deletion
+        int previous = refCount.fetch_sub(1);
+        // Objects without a pool are not on the heap
+        if (!pool) return;
+        if (previous == 1) {
+            pool->release(this);
+        } else if (candidateSlot == NO_SLOT) {
+            pool->suspect(this);
         }
     }
     
     int getRefCount() const { return refCount; }
     
-    void mark() { marked = true; }
-    void unmark() { marked = false; }
-    bool isMarked() const { return marked; }
+    void mark() { marked.store(true, std::memory_order_relaxed); }
+    void unmark() { marked.store(false, std::memory_order_relaxed); }
+    bool isMarked() const { return marked.load(std::memory_order_relaxed); }
+    // Sets the mark; false if another thread or an earlier call already had
+    bool tryMark() {
+        return !marked.load(std::memory_order_relaxed) && !marked.exchange(true, std::memory_order_relaxed);
+    }
+
+    void setGCRefs(int count) { gcRefs = count; }
+    int getGCRefs() const { return gcRefs; }
     
     void setPool(ObjectPool* p) { pool = p; }
     ObjectPool* getPool() const { return pool; }
 
     virtual std::string toString() const = 0;
+
+    // Visits every object this one holds a counted reference to
+    virtual void trace(Visitor& visitor) const = 0;
+    // Like trace(), but visits at most limit references starting at the
+    // begin-th, so a huge container can be traced in parts. Returns where to
+    // continue, or 0 once done.
+    virtual size_t tracePart(Visitor& visitor, size_t /*begin*/, size_t /*limit*/) const {
+        trace(visitor);
+        return 0;
+    }
+    // tracePart() for the concurrent marker, which runs beside the script.
+    // Returns false, having traced nothing, while the script is changing the
+    // object; containers lock against writes here.
+    virtual bool tryTracePart(Visitor& visitor, size_t begin, size_t limit, size_t& next) const {
+        next = tracePart(visitor, begin, limit);
+        return true;
+    }
+    // Drops those references; the collector calls it on garbage cycles
+    // before deleting their objects, so none is deleted while another
+    // still points to it
+    virtual void releaseReferences() {}
+
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    static constexpr int UNTRACED = -1;
 };
 
+// List and pool methods that need the full Object definition
+
+inline void ObjectList::push_back(Object* obj) {
+    obj->listPrev = tail;
+    obj->listNext = nullptr;
+    if (tail) {
+        tail->listNext = obj;
+    } else {
+        head = obj;
+    }
+    tail = obj;
+    ++count;
+}
+
+inline void ObjectList::remove(Object* obj) {
+    if (obj->listPrev) {
+        obj->listPrev->listNext = obj->listNext;
+    } else {
+        head = obj->listNext;
+    }
+    if (obj->listNext) {
+        obj->listNext->listPrev = obj->listPrev;
+    } else {
+        tail = obj->listPrev;
+    }
+    obj->listPrev = nullptr;
+    obj->listNext = nullptr;
+    --count;
+}
+
+inline void ObjectList::splice(ObjectList& other) {
+    if (!other.head) return;
+    if (tail) {
+        tail->listNext = other.head;
+        other.head->listPrev = tail;
+    } else {
+        head = other.head;
+    }
+    tail = other.tail;
+    count += other.count;
+    other.head = nullptr;
+    other.tail = nullptr;
+    other.count = 0;
+}
+
+inline Object* ObjectList::older(const Object* obj) { return obj->listPrev; }
+inline Object* ObjectList::newer(const Object* obj) { return obj->listNext; }
+
+inline void ObjectPool::adopt(Object* obj) {
+    if (freeSlots.empty()) {
+        obj->poolSlot = static_cast<uint32_t>(slots.size());
+        slots.push_back(obj);
+    } else {
+        obj->poolSlot = freeSlots.back();
+        freeSlots.pop_back();
+        slots[obj->poolSlot] = obj;
+    }
+    currentSize++;
+}
+
+inline void ObjectPool::unregister(Object* obj) {
+    uint32_t slot = obj->poolSlot;
+    if (slot == Object::NO_SLOT) return;
+    slots[slot] = nullptr;
+    freeSlots.push_back(slot);
+    obj->poolSlot = Object::NO_SLOT;
+    currentSize--;
+}
+
+// Objects a worker creates are only registered once the loop is done
+inline bool AllocationBuffer::isShared(const Object* obj) {
+    return obj->poolSlot != Object::NO_SLOT && current();
+}
+
+inline void ObjectPool::destroy(Object* obj) {
+    if (obj->sizeClass == SlabAllocator::NO_CLASS) {
+        delete obj;
+        return;
+    }
+    obj->~Object();
+    slabs.free(obj);
+}
+
 template<typename T>
 class Ref {
 private:
@@ -113,29 +254,34 @@ public:
         if (ptr) ptr->decrementRefCount();
     }
     
+    // Assignments take the new reference before dropping the old one, which
+    // may free the object other lives in
     Ref& operator=(const Ref& other) {
         if (this != &other) {
-            if (ptr) ptr->decrementRefCount();
+            T* old = ptr;
             ptr = other.ptr;
             if (ptr) ptr->incrementRefCount();
+            if (old) old->decrementRefCount();
         }
         return *this;
     }
     
     Ref& operator=(Ref&& other) noexcept {
         if (this != &other) {
-            if (ptr) ptr->decrementRefCount();
+            T* old = ptr;
             ptr = other.ptr;
             other.ptr = nullptr;
+            if (old) old->decrementRefCount();
         }
         return *this;
     }
     
     template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
     Ref& operator=(const Ref<U>& other) {
-        if (ptr) ptr->decrementRefCount();
+        T* old = ptr;
         ptr = other.get();
         if (ptr) ptr->incrementRefCount();
+        if (old) old->decrementRefCount();
         return *this;
     }
     
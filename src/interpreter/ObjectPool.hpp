@@ -1,66 +1,193 @@
 #pragma once
 
 #include "Object.hpp"
+#include "SlabAllocator.hpp"
 #include <vector>
 #include <memory>
 #include <iostream>
-#include <algorithm>
+#include <cstdint>
 #include <typeinfo>
 
-extern bool g_jeve_debug;
-
 namespace jeve {
 
-class ObjectPool {
+class GarbageCollector;
+
+// Intrusive doubly linked list of objects, oldest first. The links live in
+// the objects, so adding, removing and splicing never allocate and take
+// constant time. An object is in at most one list at a time.
+class ObjectList {
+private:
+    Object* head = nullptr;
+    Object* tail = nullptr;
+    size_t count = 0;
+
+public:
+    ObjectList() = default;
+    ObjectList(const ObjectList&) = delete;
+    ObjectList& operator=(const ObjectList&) = delete;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Object* oldest() const { return head; }
+    Object* newest() const { return tail; }
+
+    // Defined after Object, which holds the links
+    void push_back(Object* obj);
+    void remove(Object* obj);
+    // Moves every object of other to the end of this list
+    void splice(ObjectList& other);
+    static Object* older(const Object* obj);
+    static Object* newer(const Object* obj);
+};
+
+// Objects created by one worker of a parallel loop, and objects whose last
+// reference it dropped. The pool's and the collector's lists are not
+// thread-safe, so while the loop runs each worker records them here instead,
+// the lists are left alone and nothing is freed or collected. The loop hands
+// them over once every worker is done.
+class AllocationBuffer {
 private:
     std::vector<Object*> objects;
+    std::vector<Object*> released;
+
+public:
+    void add(Object* obj) { objects.push_back(obj); }
+    void release(Object* obj) { released.push_back(obj); }
+    size_t size() const { return objects.size(); }
+    const std::vector<Object*>& getObjects() const { return objects; }
+    const std::vector<Object*>& getReleased() const { return released; }
+
+    // The buffer of the calling thread, or nullptr outside a parallel loop
+    static AllocationBuffer* current();
+
+    // True on a worker of a parallel loop for an object that existed before
+    // the loop: all workers may reach it, so none may add to or remove from
+    // it, whatever variable, element or argument it is reached through.
+    // Defined after Object.
+    static bool isShared(const Object* obj);
+
+    // Makes a buffer the calling thread's for as long as it exists
+    class Use {
+    private:
+        AllocationBuffer* previous;
+
+    public:
+        explicit Use(AllocationBuffer& buffer);
+        ~Use();
+        Use(const Use&) = delete;
+        Use& operator=(const Use&) = delete;
+    };
+};
+
+// Registry of the objects an interpreter has created and not yet freed.
+// Each object remembers its slot, and freed slots are reused, so
+// registering and unregistering are constant time however many objects are
+// alive. Objects are allocated from size-class slabs.
+class ObjectPool {
+private:
+    SlabAllocator slabs;
+    std::vector<Object*> slots;
+    std::vector<uint32_t> freeSlots;
     size_t maxSize;
     size_t currentSize;
+    bool debug = false;
+    std::ostream* log = &std::cout;  // where debug traces go
+    bool marking = false;
+    bool concurrentMarking = false;
+    GarbageCollector* collector = nullptr;
 
 public:
     ObjectPool(size_t max = 16 * 1024 * 1024)
         : maxSize(max), currentSize(0) {}
 
-    ~ObjectPool() {
-        // Don't delete objects here - they are managed by reference counting
-        objects.clear();
-    }
+    // Don't delete objects here - they are managed by reference counting
+    ~ObjectPool() = default;
 
     template<typename T, typename... Args>
     T* acquire(Args&&... args) {
         if (currentSize >= maxSize) {
-            if (g_jeve_debug) {
-                std::cout << "[ObjectPool] Size limit reached! Current: " << currentSize 
+            if (debug) {
+                *log << "[ObjectPool] Size limit reached! Current: " << currentSize 
                           << ", Max: " << maxSize << std::endl;
             }
             throw std::runtime_error("Object pool size limit reached");
         }
-        T* obj = new T(std::forward<Args>(args)...);
-        objects.push_back(obj);
-        currentSize++;
-        if (g_jeve_debug) {
-            std::cout << "[ObjectPool] Created " << typeid(T).name() 
+        static_assert(alignof(T) <= SlabAllocator::GRANULE, "slab cells are 16-byte aligned");
+        constexpr uint8_t sizeClass = SlabAllocator::classFor(sizeof(T));
+        T* obj;
+        if (sizeClass == SlabAllocator::NO_CLASS) {
+            obj = new T(std::forward<Args>(args)...);
+        } else {
+            void* cell = slabs.allocate(sizeClass);
+            try {
+                obj = new (cell) T(std::forward<Args>(args)...);
+            } catch (...) {
+                slabs.free(cell);
+                throw;
+            }
+        }
+        obj->sizeClass = sizeClass;
+        adopt(obj);
+        if (debug) {
+            *log << "[ObjectPool] Created " << typeid(T).name() 
                       << " (Total objects: " << currentSize << ")" << std::endl;
         }
         return obj;
     }
 
-    void release(Object* obj) {
-        if (!obj) return;
-        auto it = std::find(objects.begin(), objects.end(), obj);
-        if (it != objects.end()) {
-            objects.erase(it);
-            currentSize--;
-            // Don't delete here - let the garbage collector handle it
-        }
-    }
+    // Called when an object's last reference goes away: the collector frees
+    // it, or inside a parallel loop, once the loop is done
+    void release(Object* obj);
+    // Called when an object loses a reference but keeps others: it may now
+    // be kept alive only by a garbage cycle
+    void suspect(Object* obj);
+
+    // True while an incremental collection is marking; every new reference
+    // made meanwhile shades its object so marking cannot miss it
+    bool isMarking() const { return marking; }
+    void setMarking(bool enabled) { marking = enabled; }
+    void shade(Object* obj);
+
+    // True while a marker thread traces the heap beside the script: the
+    // script then takes a container's lock to change it. Only the script's
+    // own thread changes it, and never while a parallel loop runs.
+    bool isMarkingConcurrently() const { return concurrentMarking; }
+    void setMarkingConcurrently(bool enabled) { concurrentMarking = enabled; }
+
+    // Registers an object, including one created while a parallel loop ran.
+    // Defined after Object.
+    void adopt(Object* obj);
+    // Unregistering an object twice is harmless. Defined after Object.
+    void unregister(Object* obj);
+    // Destroys an object and frees its memory, whether it came from
+    // acquire() or from new. Defined after Object.
+    void destroy(Object* obj);
+
+    // The collector that owns this pool and registers its objects
+    void setCollector(GarbageCollector* gc) { collector = gc; }
+    GarbageCollector* getCollector() const { return collector; }
+
+    void setDebug(bool enabled) { debug = enabled; }
+    void setLog(std::ostream& out) { log = &out; }
 
     void printStats() const {
-        if (g_jeve_debug) {
-            std::cout << "[ObjectPool] Current size: " << currentSize 
+        if (debug) {
+            *log << "[ObjectPool] Current size: " << currentSize 
                       << ", Max size: " << maxSize << std::endl;
         }
     }
+
+    // Slabs and cells of each size class, and the heap region they are in
+    void printSlabStats(std::ostream& out) const { slabs.printStats(out); }
+
+    // Reserves the region slabs are taken from; see SlabAllocator::reserve
+    void reserveHeap(size_t maxBytes, size_t initialBytes) { slabs.reserve(maxBytes, initialBytes); }
+    void useHugePages() { slabs.useHugePages(); }
+    // Returns the memory of heap chunks left empty to the system
+    void trimHeap() { slabs.trim(); }
+    // Bytes of slabs holding objects, and how many objects they hold
+    size_t getSlabBytes() const { return slabs.getBytesInUse(); }
+    size_t getSlabObjects() const { return slabs.getLiveCells(); }
 };
 
 } // namespace jeve 
\ No newline at end of file
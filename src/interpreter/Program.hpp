@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Arena.hpp"
+#include "ASTNode.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jeve {
+
+class BlockNode;
+class UserFunctionNode;
+
+// Supplies the function bodies of a program that was not parsed from source,
+// such as one restored from a heap snapshot
+class BodyDecoder {
+public:
+    virtual ~BodyDecoder() = default;
+    // Builds the body stored at offset into the program's arena
+    virtual BlockNode* decode(size_t offset) = 0;
+};
+
+// A fully parsed script. Every AST node is allocated from the program's arena
+// and lives exactly as long as the program; none of them are GC objects.
+class Program {
+private:
+    std::string source;
+    Arena arena;
+    std::vector<ASTNode*> statements;
+    std::vector<UserFunctionNode*> functions;
+    std::mutex parseMutex;  // held while a function body is parsed into the arena
+    std::vector<std::unique_ptr<Arena>> extraArenas;  // from parallel compilation
+    std::unique_ptr<BodyDecoder> bodyDecoder;  // lazy bodies come from here instead of the source
+
+public:
+    explicit Program(std::string code = std::string()) : source(std::move(code)) {}
+
+    const std::string& getSource() const { return source; }
+
+    Arena& getArena() { return arena; }
+    const Arena& getArena() const { return arena; }
+    // Keeps nodes that were allocated elsewhere alive as long as the program
+    void adoptArena(std::unique_ptr<Arena> other) { extraArenas.push_back(std::move(other)); }
+
+    void addStatement(ASTNode* statement) { statements.push_back(statement); }
+    void addFunction(UserFunctionNode* function) { functions.push_back(function); }
+
+    const std::vector<ASTNode*>& getStatements() const { return statements; }
+    const std::vector<UserFunctionNode*>& getFunctions() const { return functions; }
+
+    std::mutex& getParseMutex() { return parseMutex; }
+
+    BodyDecoder* getBodyDecoder() const { return bodyDecoder.get(); }
+    void setBodyDecoder(std::unique_ptr<BodyDecoder> decoder) { bodyDecoder = std::move(decoder); }
+};
+
+} // namespace jeve
@@ -0,0 +1,207 @@
+#include "ProgramCache.hpp"
+#include "JeveInterpreter.hpp"
+#include "MappedFile.hpp"
+#include "Program.hpp"
+#include "ProgramReader.hpp"
+#include "ast/FunctionNodes.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef JEVE_VERSION
+#define JEVE_VERSION "dev"
+#endif
+
+namespace jeve {
+
+void ProgramWriter::node(const ASTNode* n) {
+    if (n) {
+        n->serialize(*this);
+    } else {
+        tag(NodeTag::None);
+    }
+}
+
+uint32_t ProgramWriter::functionTable(const std::vector<UserFunctionNode*>& functions) {
+    std::vector<uint32_t> offsets;
+    // By index: writing a body can parse it and append the functions it defines
+    for (size_t i = 0; i < functions.size(); ++i) {
+        offsets.push_back(static_cast<uint32_t>(body.size()));
+        node(functions[i]->getBody());
+    }
+    uint32_t table = static_cast<uint32_t>(body.size());
+    for (size_t i = 0; i < functions.size(); ++i) {
+        string(functions[i]->getName());
+        stringList(functions[i]->getParams());
+        u32(offsets[i]);
+    }
+    return table;
+}
+
+namespace {
+
+constexpr char CACHE_MAGIC[4] = {'J', 'E', 'V', 'C'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t format;
+    uint32_t byteOrder;
+    uint32_t stringCount;
+    uint64_t key;
+    uint32_t functionCount;
+    uint32_t statementCount;
+    uint32_t tableOffset;  // where the function table starts after the bodies
+};
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnv1a(std::string_view text, uint64_t hash = FNV_OFFSET) {
+    for (char c : text) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// FNV-1a over 8-byte words, so hashing a large script costs far less than lexing it
+uint64_t fnv1aWords(std::string_view text, uint64_t hash) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= text.size(); i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, text.data() + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    return fnv1a(text.substr(i), hash);
+}
+
+} // namespace
+
+namespace ProgramCache {
+
+uint64_t key(std::string_view source) {
+    uint64_t seed = fnv1a(JEVE_VERSION);
+    seed = fnv1a(std::string_view(reinterpret_cast<const char*>(&FORMAT_VERSION), sizeof(FORMAT_VERSION)), seed);
+    uint64_t size = source.size();
+    seed = fnv1a(std::string_view(reinterpret_cast<const char*>(&size), sizeof(size)), seed);
+    return fnv1aWords(source, seed);
+}
+
+std::string pathFor(const std::string& scriptPath, const std::string& cacheDir) {
+    if (cacheDir.empty()) {
+        return scriptPath + "c";
+    }
+    size_t slash = scriptPath.find_last_of("/\\");
+    std::string base = slash == std::string::npos ? scriptPath : scriptPath.substr(slash + 1);
+    char suffix[17];
+    std::snprintf(suffix, sizeof(suffix), "%016llx", static_cast<unsigned long long>(fnv1a(scriptPath)));
+    std::string dir = cacheDir;
+    if (dir.back() != '/' && dir.back() != '\\') dir += '/';
+    return dir + base + "-" + suffix + ".jevec";
+}
+
+std::unique_ptr<Program> load(const std::string& path, uint64_t key, JeveInterpreter& interpreter) {
+    auto program = std::make_unique<Program>();
+    auto bodies = std::make_unique<MappedBodies>(path, interpreter, *program, "script cache " + path);
+    const MappedFile& file = bodies->getFile();
+    if (!file.getData() || file.getSize() < sizeof(CacheHeader)) {
+        return nullptr;
+    }
+    CacheHeader header;
+    std::memcpy(&header, file.getData(), sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.format != FORMAT_VERSION || header.byteOrder != BYTE_ORDER_MARK || header.key != key) {
+        return nullptr;
+    }
+
+    try {
+        ProgramReader pool(file.getData() + sizeof(header), file.getData() + file.getSize(), interpreter, *program);
+        pool.readStrings(header.stringCount);
+        if (static_cast<size_t>(file.getData() + file.getSize() - pool.position()) < header.tableOffset) {
+            throw std::runtime_error("Bad function table offset");
+        }
+        const char* table = pool.position() + header.tableOffset;
+        bodies->setBodies(pool.getStrings(), pool.position(), table);
+
+        ProgramReader reader(table, file.getData() + file.getSize(), interpreter, *program, pool.getStrings());
+        reader.functionTable(header.functionCount, header.tableOffset);
+        for (uint32_t i = 0; i < header.statementCount; ++i) {
+            program->addStatement(reader.node());
+        }
+        if (!reader.atEnd()) {
+            throw std::runtime_error("Trailing bytes after the last node");
+        }
+    } catch (const std::exception& e) {
+        if (interpreter.isDebug()) {
+            interpreter.getOutput() << "[Jeve] Ignoring script cache " << path << ": " << e.what() << std::endl;
+        }
+        return nullptr;
+    }
+    program->setBodyDecoder(std::move(bodies));
+    return program;
+}
+
+bool save(const Program& program, const std::string& path, uint64_t key) {
+    ProgramWriter writer;
+    uint32_t tableOffset;
+    try {
+        tableOffset = writer.functionTable(program.getFunctions());
+    } catch (const std::exception&) {
+        // A body with a syntax error only fails when it is called, so don't cache it
+        return false;
+    }
+    for (const ASTNode* statement : program.getStatements()) {
+        writer.node(statement);
+    }
+
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.format = FORMAT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.stringCount = static_cast<uint32_t>(writer.getStrings().size());
+    header.key = key;
+    header.functionCount = static_cast<uint32_t>(program.getFunctions().size());
+    header.statementCount = static_cast<uint32_t>(program.getStatements().size());
+    header.tableOffset = tableOffset;
+
+    std::string pool = writer.encodeStrings();
+    return writeFile(path, {std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)),
+                            pool, writer.getBody()});
+}
+
+bool writeFile(const std::string& path, std::initializer_list<std::string_view> parts) {
+    // Unique per process and thread so parallel runs of one script don't collide
+    uint64_t nonce = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+                     std::hash<std::thread::id>()(std::this_thread::get_id());
+    std::string temporary = path + ".tmp" + std::to_string(nonce);
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        for (std::string_view part : parts) {
+            out.write(part.data(), static_cast<std::streamsize>(part.size()));
+        }
+        if (!out) {
+            out.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+#if defined(_WIN32)
+    // rename() does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace ProgramCache
+
+} // namespace jeve
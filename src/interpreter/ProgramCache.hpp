@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace jeve {
+
+class ASTNode;
+class JeveInterpreter;
+class Program;
+class UserFunctionNode;
+
+// One tag per node type in a serialized program. Append new tags at the end
+// and bump ProgramCache::FORMAT_VERSION whenever a node's fields change.
+enum class NodeTag : uint8_t {
+    None = 0,
+    Number,
+    String,
+    Identifier,
+    Boolean,
+    BinaryOp,
+    UnaryOp,
+    Concat,
+    PropertyAccess,
+    Array,
+    ArrayAccess,
+    ArrayAssignment,
+    Assignment,
+    Block,
+    If,
+    While,
+    For,
+    SmartLoop,
+    Return,
+    Print,
+    Input,
+    FunctionCall,
+    UserFunction,
+    DebugGC,
+    CleanGC,
+    ParallelFor
+};
+
+// Flattens an AST into a pre-order stream of tags and fields. Strings go
+// into a shared pool and are written as indices into it.
+class ProgramWriter {
+private:
+    std::string body;
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, uint32_t> stringIndex;
+
+    // Little-endian base-128: most counts, indices and literals fit in one byte
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            body.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        body.push_back(static_cast<char>(value));
+    }
+
+public:
+    void tag(NodeTag t) { u8(static_cast<uint8_t>(t)); }
+    void u8(uint8_t value) { body.push_back(static_cast<char>(value)); }
+    void u32(uint32_t value) { varint(value); }
+    void f64(double value) { raw(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void raw(const char* data, size_t size) { body.append(data, size); }
+    // Zigzag keeps small negative numbers short too
+    void i64(int64_t value) { varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63)); }
+
+    // The string must outlive the writer; every caller passes a node's own member
+    void string(const std::string& value) {
+        auto it = stringIndex.find(value);
+        if (it == stringIndex.end()) {
+            it = stringIndex.emplace(value, static_cast<uint32_t>(strings.size())).first;
+            strings.push_back(value);
+        }
+        u32(it->second);
+    }
+
+    void stringList(const std::vector<std::string>& values) {
+        u32(static_cast<uint32_t>(values.size()));
+        for (const std::string& value : values) string(value);
+    }
+
+    // Writes NodeTag::None for a missing child
+    void node(const ASTNode* n);
+
+    // Writes every body, then a table of names, parameters and body offsets,
+    // so readers can skip each body until its function is called. Returns
+    // where the table starts. Functions that bodies define while being
+    // written are included.
+    uint32_t functionTable(const std::vector<UserFunctionNode*>& functions);
+
+    void nodes(const std::vector<ASTNode*>& values) {
+        u32(static_cast<uint32_t>(values.size()));
+        for (const ASTNode* value : values) node(value);
+    }
+
+    const std::string& getBody() const { return body; }
+    const std::vector<std::string_view>& getStrings() const { return strings; }
+
+    // The pool as written to disk: each string's length followed by its bytes
+    std::string encodeStrings() const {
+        ProgramWriter pool;
+        for (std::string_view s : strings) {
+            pool.u32(static_cast<uint32_t>(s.size()));
+            pool.raw(s.data(), s.size());
+        }
+        return std::move(pool.body);
+    }
+};
+
+// Compiled-script cache. A .jevec file holds a header keyed by the source
+// hash and interpreter version, the string pool, the function bodies, the
+// function table and the top-level statements. Loading maps the file and
+// rebuilds the statements straight into a program's arena without lexing or
+// parsing; function bodies are rebuilt from the mapping on first call.
+namespace ProgramCache {
+
+constexpr uint32_t FORMAT_VERSION = 2;
+
+// Hash of the source text and the interpreter version; a cache file is only
+// used when its key matches
+uint64_t key(std::string_view source);
+
+// Cache file for a script: <script>c next to it, or one file per script
+// path in cacheDir. Stale files are simply overwritten.
+std::string pathFor(const std::string& scriptPath, const std::string& cacheDir);
+
+// Returns nullptr when the file is missing, stale or unreadable. The loaded
+// program has every node but keeps no source text.
+std::unique_ptr<Program> load(const std::string& path, uint64_t key, JeveInterpreter& interpreter);
+
+// Returns false if the file could not be written
+bool save(const Program& program, const std::string& path, uint64_t key);
+
+// Writes the parts one after another through a temporary file, so
+// concurrent readers never see a partial file
+bool writeFile(const std::string& path, std::initializer_list<std::string_view> parts);
+
+} // namespace ProgramCache
+
+} // namespace jeve
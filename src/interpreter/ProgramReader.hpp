@@ -0,0 +1,338 @@
+#pragma once
+
+#include "JeveInterpreter.hpp"
+#include "MappedFile.hpp"
+#include "Program.hpp"
+#include "ProgramCache.hpp"
+#include "ast/ArrayNodes.hpp"
+#include "ast/AssignmentNode.hpp"
+#include "ast/BasicNodes.hpp"
+#include "ast/ConcatNode.hpp"
+#include "ast/ControlFlowNodes.hpp"
+#include "ast/FunctionNodes.hpp"
+#include "ast/GCNodes.hpp"
+#include "ast/IONodes.hpp"
+#include "ast/OperatorNodes.hpp"
+#include "ast/PropertyAccessNode.hpp"
+#include "ast/SmartLoopNode.hpp"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jeve {
+
+// Rebuilds nodes from a ProgramWriter stream into a program's arena. Used
+// by the script cache and by heap snapshots; every read is bounds-checked
+// and malformed input throws std::runtime_error.
+class ProgramReader {
+private:
+    const char* cursor;
+    const char* end;
+    std::vector<std::string_view> ownStrings;
+    const std::vector<std::string_view>* strings = &ownStrings;
+    JeveInterpreter& interpreter;
+    Program& program;
+    size_t depth = 0;
+
+    // Corrupt files could otherwise nest deeply enough to overflow the stack
+    static constexpr size_t MAX_NODE_DEPTH = 10000;
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        return program.getArena().create<T>(std::forward<Args>(args)...);
+    }
+
+public:
+    ProgramReader(const char* begin, const char* stop, JeveInterpreter& interp, Program& prog)
+        : cursor(begin), end(stop), interpreter(interp), program(prog) {}
+    // Shares a string pool already read by another reader of the same file
+    ProgramReader(const char* begin, const char* stop, JeveInterpreter& interp, Program& prog,
+                  const std::vector<std::string_view>& pool)
+        : cursor(begin), end(stop), strings(&pool), interpreter(interp), program(prog) {}
+
+    const char* position() const { return cursor; }
+    const std::vector<std::string_view>& getStrings() const { return *strings; }
+
+    void need(size_t bytes) const {
+        if (static_cast<size_t>(end - cursor) < bytes) {
+            throw std::runtime_error("Unexpected end of compiled data");
+        }
+    }
+
+    template<typename T>
+    T read() {
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = read<uint8_t>();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Bad integer");
+    }
+
+    uint32_t u32() {
+        uint64_t value = varint();
+        if (value > UINT32_MAX) throw std::runtime_error("Bad count");
+        return static_cast<uint32_t>(value);
+    }
+
+    double f64() { return read<double>(); }
+
+    int64_t i64() {
+        uint64_t value = varint();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    // Every entry takes at least one byte, which bounds counts from corrupt files
+    uint32_t count() {
+        uint32_t n = u32();
+        need(n);
+        return n;
+    }
+
+    std::string string() {
+        uint32_t index = u32();
+        if (index >= strings->size()) {
+            throw std::runtime_error("Bad string index");
+        }
+        return std::string((*strings)[index]);
+    }
+
+    std::vector<std::string> stringList() {
+        std::vector<std::string> values(count());
+        for (std::string& value : values) value = string();
+        return values;
+    }
+
+    std::vector<ASTNode*> nodes() {
+        std::vector<ASTNode*> values(count());
+        for (ASTNode*& value : values) value = node();
+        return values;
+    }
+
+    BlockNode* block(bool required = true) {
+        ASTNode* n = required ? node() : optional();
+        BlockNode* b = dynamic_cast<BlockNode*>(n);
+        if (n && !b) {
+            throw std::runtime_error("Expected a block node");
+        }
+        return b;
+    }
+
+    template<typename Enum>
+    Enum enumValue(Enum last) {
+        uint8_t value = read<uint8_t>();
+        if (value > static_cast<uint8_t>(last)) {
+            throw std::runtime_error("Bad operator");
+        }
+        return static_cast<Enum>(value);
+    }
+
+private:
+    ASTNode* build(NodeTag tag) {
+        switch (tag) {
+            case NodeTag::None:
+                return nullptr;
+            case NodeTag::Number:
+                return make<NumberNode>(i64());
+            case NodeTag::String:
+                return make<StringNode>(string());
+            case NodeTag::Identifier:
+                return make<IdentifierNode>(string());
+            case NodeTag::Boolean:
+                return make<BooleanNode>(read<uint8_t>() != 0);
+            case NodeTag::BinaryOp: {
+                BinaryOperator op = enumValue(BinaryOperator::Or);
+                ASTNode* left = node();
+                ASTNode* right = node();
+                return make<BinaryOpNode>(left, right, op);
+            }
+            case NodeTag::UnaryOp: {
+                UnaryOperator op = enumValue(UnaryOperator::Not);
+                return make<UnaryOpNode>(node(), op);
+            }
+            case NodeTag::Concat: {
+                ASTNode* left = node();
+                ASTNode* right = node();
+                return make<ConcatNode>(left, right);
+            }
+            case NodeTag::PropertyAccess: {
+                std::string property = string();
+                return make<PropertyAccessNode>(node(), property);
+            }
+            case NodeTag::Array:
+                return make<ArrayNode>(nodes(), interpreter.getGC().getObjectPool());
+            case NodeTag::ArrayAccess: {
+                ASTNode* array = node();
+                ASTNode* index = node();
+                return make<ArrayAccessNode>(array, index);
+            }
+            case NodeTag::ArrayAssignment: {
+                ASTNode* array = node();
+                ASTNode* index = node();
+                ASTNode* value = node();
+                return make<ArrayAssignmentNode>(array, index, value);
+            }
+            case NodeTag::Assignment: {
+                std::string name = string();
+                std::string type = string();
+                return make<AssignmentNode>(name, node(), type);
+            }
+            case NodeTag::Block: {
+                BlockNode* b = make<BlockNode>();
+                for (ASTNode* statement : nodes()) b->addStatement(statement);
+                return b;
+            }
+            case NodeTag::If: {
+                ASTNode* condition = node();
+                BlockNode* thenBlock = block();
+                BlockNode* elseBlock = block(false);
+                return make<IfNode>(condition, thenBlock, elseBlock);
+            }
+            case NodeTag::While: {
+                ASTNode* condition = node();
+                return make<WhileNode>(condition, block());
+            }
+            case NodeTag::For: {
+                std::string var = string();
+                ASTNode* start = node();
+                ASTNode* stop = node();
+                ASTNode* step = optional();
+                return make<ForNode>(var, start, stop, step, block());
+            }
+            case NodeTag::ParallelFor: {
+                std::string var = string();
+                ASTNode* start = node();
+                ASTNode* stop = node();
+                ASTNode* step = optional();
+                BlockNode* body = block();
+                std::vector<ReductionVariable> reductions(count());
+                for (ReductionVariable& reduction : reductions) {
+                    reduction.op = enumValue(Reduction::Max);
+                    reduction.name = string();
+                }
+                return make<ParallelForNode>(var, start, stop, step, body, std::move(reductions), &interpreter);
+            }
+            case NodeTag::SmartLoop: {
+                std::string valueName = string();
+                std::string indexName = string();
+                ASTNode* array = node();
+                return make<SmartLoopNode>(valueName, indexName, array, block());
+            }
+            case NodeTag::Return:
+                return make<ReturnNode>(optional());
+            case NodeTag::Print:
+                return make<PrintNode>(node(), &interpreter);
+            case NodeTag::Input:
+                return make<InputNode>(string(), &interpreter);
+            case NodeTag::FunctionCall: {
+                std::string name = string();
+                return make<FunctionCallNode>(std::move(name), nodes(), &interpreter);
+            }
+            case NodeTag::UserFunction: {
+                std::string name = string();
+                std::vector<std::string> params = stringList();
+                return make<UserFunctionNode>(name, params, node(), &interpreter);
+            }
+            case NodeTag::DebugGC:
+                return make<DebugGCNode>(&interpreter.getGC());
+            case NodeTag::CleanGC:
+                return make<CleanGCNode>(&interpreter.getGC());
+        }
+        throw std::runtime_error("Unknown node tag");
+    }
+
+public:
+
+    void readStrings(uint32_t n) {
+        need(n);
+        strings = &ownStrings;
+        ownStrings.reserve(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint32_t length = u32();
+            need(length);
+            ownStrings.emplace_back(cursor, length);
+            cursor += length;
+        }
+    }
+
+    // A child that may be absent, such as an else block
+    ASTNode* optional() {
+        if (++depth > MAX_NODE_DEPTH) {
+            throw std::runtime_error("Compiled nodes nest too deeply");
+        }
+        ASTNode* n = build(static_cast<NodeTag>(read<uint8_t>()));
+        depth--;
+        return n;
+    }
+
+    ASTNode* node() {
+        ASTNode* n = optional();
+        if (!n) {
+            throw std::runtime_error("Missing node");
+        }
+        return n;
+    }
+
+    // Reads a table written by ProgramWriter::functionTable. The functions
+    // are added to the program with their bodies left for its BodyDecoder.
+    void functionTable(uint32_t n, size_t bodiesSize) {
+        for (uint32_t i = 0; i < n; ++i) {
+            std::string name = string();
+            std::vector<std::string> params = stringList();
+            uint32_t offset = u32();
+            if (offset >= bodiesSize) throw std::runtime_error("Bad function body offset");
+            program.addFunction(make<UserFunctionNode>(name, params, &program, offset, &interpreter));
+        }
+    }
+
+    bool atEnd() const { return cursor == end; }
+};
+
+// Function bodies in a mapped compiled file, each rebuilt the first time its
+// function is called. Owned by the program, which keeps the mapping alive.
+class MappedBodies : public BodyDecoder {
+private:
+    MappedFile file;
+    JeveInterpreter& interpreter;
+    Program& program;
+    std::string kind;  // what the file is, for error messages
+    std::vector<std::string_view> strings;
+    const char* bodies = nullptr;
+    const char* bodiesEnd = nullptr;
+
+public:
+    MappedBodies(const std::string& path, JeveInterpreter& interp, Program& prog, std::string fileKind)
+        : file(path), interpreter(interp), program(prog), kind(std::move(fileKind)) {}
+
+    const MappedFile& getFile() const { return file; }
+
+    // Called once the string pool has been read; the bodies follow it
+    void setBodies(const std::vector<std::string_view>& pool, const char* begin, const char* stop) {
+        strings = pool;
+        bodies = begin;
+        bodiesEnd = stop;
+    }
+
+    BlockNode* decode(size_t offset) override {
+        try {
+            ProgramReader reader(bodies + offset, bodiesEnd, interpreter, program, strings);
+            return reader.block();
+        } catch (const std::exception& e) {
+            throw std::runtime_error("Invalid " + kind + ": " + e.what());
+        }
+    }
+};
+
+} // namespace jeve
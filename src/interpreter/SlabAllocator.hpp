@@ -0,0 +1,246 @@
+#pragma once
+
+#include "HeapRegion.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace jeve {
+
+// Size-segregated slab allocator for heap objects. Each size class carves
+// SLAB_SIZE-aligned slabs into cells of one size, so objects of a type sit
+// next to each other. Every slab keeps its own free list and count of live
+// cells in a header at its start, found from a cell by masking its address;
+// allocating and freeing are a few instructions on the common path. Slabs
+// come from a reserved HeapRegion when there is one, which takes back slabs
+// whose cells are all free; otherwise they come from the C heap and such
+// slabs go to a cache any class can reuse.
+// Not thread-safe: only the interpreter's own thread allocates here.
+class SlabAllocator {
+public:
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+    static constexpr size_t GRANULE = 16;
+    static constexpr size_t CLASS_COUNT = 32;  // cells of 16 to 512 bytes
+    static constexpr uint8_t NO_CLASS = 0xFF;  // too large; allocated with new
+
+    // Size class for an object of size bytes, or NO_CLASS
+    static constexpr uint8_t classFor(size_t size) {
+        if (size == 0 || size > GRANULE * CLASS_COUNT) return NO_CLASS;
+        return static_cast<uint8_t>((size + GRANULE - 1) / GRANULE - 1);
+    }
+
+private:
+    struct Slab {
+        void* freeCells = nullptr;  // cells freed since the slab was carved
+        char* unused;               // cells never handed out start here
+        char* end;
+        uint32_t live = 0;
+        uint8_t sizeClass;
+        bool listed = false;        // in its class's list of slabs with room
+        Slab* prev = nullptr;
+        Slab* next = nullptr;
+    };
+
+    struct SizeClass {
+        size_t cellSize;
+        Slab* current = nullptr;   // where cells come from
+        Slab* withRoom = nullptr;  // other slabs with free cells
+        size_t slabs = 0;
+        size_t live = 0;
+        size_t allocations = 0;
+    };
+
+    SizeClass classes[CLASS_COUNT];
+    HeapRegion region;
+    std::vector<Slab*> slabs;  // every slab from the C heap, for teardown
+    Slab* emptySlabs = nullptr;
+    size_t slabsInUse = 0;
+    size_t liveCells = 0;
+
+    static Slab* slabOf(void* cell) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(cell) & ~(SLAB_SIZE - 1));
+    }
+
+    static char* firstCell(Slab* slab) {
+        constexpr size_t header = (sizeof(Slab) + GRANULE - 1) / GRANULE * GRANULE;
+        return reinterpret_cast<char*>(slab) + header;
+    }
+
+    void* allocateSlabMemory() {
+        if (region.isReserved()) {
+            void* memory = region.allocateSlab();
+            if (!memory) throw std::runtime_error("Out of memory: max heap size reached");
+            return memory;
+        }
+#ifdef _WIN32
+        void* memory = _aligned_malloc(SLAB_SIZE, SLAB_SIZE);
+#else
+        void* memory = std::aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+#endif
+        if (!memory) throw std::bad_alloc();
+        slabs.push_back(static_cast<Slab*>(memory));
+        return memory;
+    }
+
+    static void releaseSlabMemory(void* memory) {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+    void link(SizeClass& c, Slab* slab) {
+        slab->listed = true;
+        slab->prev = nullptr;
+        slab->next = c.withRoom;
+        if (c.withRoom) c.withRoom->prev = slab;
+        c.withRoom = slab;
+    }
+
+    void unlink(SizeClass& c, Slab* slab) {
+        if (slab->prev) {
+            slab->prev->next = slab->next;
+        } else {
+            c.withRoom = slab->next;
+        }
+        if (slab->next) slab->next->prev = slab->prev;
+        slab->listed = false;
+        slab->prev = nullptr;
+        slab->next = nullptr;
+    }
+
+    // Gives a class a slab with room once its current one is full
+    Slab* refill(uint8_t sizeClass) {
+        SizeClass& c = classes[sizeClass];
+        Slab* slab = c.withRoom;
+        if (slab) {
+            unlink(c, slab);
+        } else {
+            if (emptySlabs) {
+                slab = emptySlabs;
+                emptySlabs = slab->next;
+            } else {
+                slab = static_cast<Slab*>(allocateSlabMemory());
+            }
+            slab->freeCells = nullptr;
+            slab->unused = firstCell(slab);
+            slab->end = reinterpret_cast<char*>(slab) + SLAB_SIZE;
+            slab->live = 0;
+            slab->sizeClass = sizeClass;
+            slab->listed = false;
+            slab->prev = nullptr;
+            slab->next = nullptr;
+            ++c.slabs;
+            ++slabsInUse;
+        }
+        c.current = slab;
+        return slab;
+    }
+
+public:
+    SlabAllocator() {
+        for (size_t i = 0; i < CLASS_COUNT; ++i) classes[i].cellSize = (i + 1) * GRANULE;
+    }
+
+    ~SlabAllocator() {
+        // Slabs with live cells are left alone: something outside the heap
+        // may still hold one of their objects
+        if (liveCells != 0) region.keepMapped();
+        for (Slab* slab : slabs) {
+            if (slab->live == 0) releaseSlabMemory(slab);
+        }
+    }
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    // Takes slabs from a region of maxBytes reserved up front, initialBytes
+    // of it committed, from now on. Call before allocating; keeps using the
+    // C heap if the region cannot be reserved.
+    void reserve(size_t maxBytes, size_t initialBytes) {
+        region.reserve(maxBytes, initialBytes, SLAB_SIZE);
+    }
+
+    void useHugePages() { region.useHugePages(); }
+
+    // Hands back the memory of the region's chunks that no longer hold any
+    // slab in use
+    void trim() {
+        if (region.isReserved()) region.trim();
+    }
+
+    // Bytes of the slabs size classes hold, and objects in them
+    size_t getBytesInUse() const { return slabsInUse * SLAB_SIZE; }
+    size_t getLiveCells() const { return liveCells; }
+
+    void* allocate(uint8_t sizeClass) {
+        SizeClass& c = classes[sizeClass];
+        Slab* slab = c.current;
+        void* cell;
+        if (slab && slab->freeCells) {
+            cell = slab->freeCells;
+            slab->freeCells = *static_cast<void**>(cell);
+        } else {
+            if (!slab || slab->unused + c.cellSize > slab->end) slab = refill(sizeClass);
+            if (slab->freeCells) {
+                cell = slab->freeCells;
+                slab->freeCells = *static_cast<void**>(cell);
+            } else {
+                cell = slab->unused;
+                slab->unused += c.cellSize;
+            }
+        }
+        ++slab->live;
+        ++c.live;
+        ++c.allocations;
+        ++liveCells;
+        return cell;
+    }
+
+    void free(void* cell) {
+        Slab* slab = slabOf(cell);
+        SizeClass& c = classes[slab->sizeClass];
+        *static_cast<void**>(cell) = slab->freeCells;
+        slab->freeCells = cell;
+        --slab->live;
+        --c.live;
+        --liveCells;
+        if (slab == c.current) return;
+        if (slab->live == 0) {
+            // Empty: any class may reuse it
+            if (slab->listed) unlink(c, slab);
+            --c.slabs;
+            --slabsInUse;
+            if (region.isReserved()) {
+                region.releaseSlab(slab);
+            } else {
+                slab->next = emptySlabs;
+                emptySlabs = slab;
+            }
+        } else if (!slab->listed) {
+            link(c, slab);
+        }
+    }
+
+    // One line per size class in use: its slabs, live cells and how many
+    // cells it has handed out in all. Then the region's size, if reserved.
+    void printStats(std::ostream& out) const {
+        for (const SizeClass& c : classes) {
+            if (c.allocations == 0) continue;
+            out << "[Slab] " << c.cellSize << " B: " << c.slabs << " slabs, " << c.live
+                << " live, " << c.allocations << " allocated" << std::endl;
+        }
+        if (region.isReserved()) {
+            out << "[Heap] " << region.getReserved() << " bytes reserved, " << region.getCommitted()
+                << " committed, " << getBytesInUse() << " in slabs, " << region.getTrimmed()
+                << " handed back" << std::endl;
+        }
+    }
+};
+
+} // namespace jeve
@@ -0,0 +1,155 @@
+#include "Sorting.hpp"
+#include <cmath>
+#include <stdexcept>
+
+namespace jeve {
+
+namespace {
+
+// Below this size a comparison sort beats the fixed cost of eight radix passes
+constexpr size_t RADIX_MIN_SIZE = 256;
+
+void radixSortRange(int64_t* keys, size_t count) {
+    if (count < RADIX_MIN_SIZE) {
+        std::sort(keys, keys + count);
+        return;
+    }
+
+    // Flip the sign bit so that unsigned byte order matches signed order
+    std::vector<uint64_t> buffer(count);
+    std::vector<uint64_t> bits(count);
+    for (size_t i = 0; i < count; ++i) {
+        bits[i] = static_cast<uint64_t>(keys[i]) ^ (1ULL << 63);
+    }
+
+    uint64_t* source = bits.data();
+    uint64_t* target = buffer.data();
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < count; ++i) {
+            counts[(source[i] >> shift) & 0xFF]++;
+        }
+        // Skip passes where every key shares the same byte
+        if (counts[(source[0] >> shift) & 0xFF] == count) continue;
+
+        size_t offset = 0;
+        for (size_t& c : counts) {
+            size_t next = offset + c;
+            c = offset;
+            offset = next;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            target[counts[(source[i] >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, target);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = static_cast<int64_t>(source[i] ^ (1ULL << 63));
+    }
+}
+
+// NaN sorts after every other number so the ordering stays strict and weak
+bool lessNumber(double a, double b) {
+    if (std::isnan(a)) return false;
+    if (std::isnan(b)) return true;
+    return a < b;
+}
+
+double numericValue(const Value& value) {
+    return value.getType() == Value::Type::Integer ? static_cast<double>(value.getInteger()) : value.getFloat();
+}
+
+bool useParallel(size_t size, ThreadPool* pool, size_t parallelThreshold) {
+    return pool && pool->size() > 1 && parallelThreshold > 0 && size >= parallelThreshold;
+}
+
+// Sorts unboxed keys extracted from the array and writes them back
+template<typename Key, typename Less, typename SortChunk>
+void sortKeys(std::vector<Key>& keys, ThreadPool* pool, size_t parallelThreshold, Less less, SortChunk sortChunk) {
+    if (useParallel(keys.size(), pool, parallelThreshold)) {
+        parallelMergeSort(keys, *pool, less, sortChunk);
+    } else {
+        sortChunk(keys.begin(), keys.end());
+    }
+}
+
+} // namespace
+
+void radixSort(std::vector<int64_t>& keys) {
+    radixSortRange(keys.data(), keys.size());
+}
+
+void sortValues(std::vector<Value>& elements, ThreadPool* pool, size_t parallelThreshold) {
+    if (elements.size() < 2) return;
+
+    bool allIntegers = true;
+    bool allNumbers = true;
+    bool allStrings = true;
+    bool allBooleans = true;
+    for (const auto& element : elements) {
+        Value::Type type = element.getType();
+        allIntegers = allIntegers && type == Value::Type::Integer;
+        allNumbers = allNumbers && (type == Value::Type::Integer || type == Value::Type::Float);
+        allStrings = allStrings && type == Value::Type::String;
+        allBooleans = allBooleans && type == Value::Type::Boolean;
+    }
+
+    if (allIntegers) {
+        std::vector<int64_t> keys(elements.size());
+        for (size_t i = 0; i < elements.size(); ++i) keys[i] = elements[i].getInteger();
+        sortKeys(keys, pool, parallelThreshold, std::less<int64_t>(),
+                 [](std::vector<int64_t>::iterator first, std::vector<int64_t>::iterator last) {
+                     radixSortRange(&*first, static_cast<size_t>(last - first));
+                 });
+        for (size_t i = 0; i < elements.size(); ++i) elements[i] = Value(keys[i]);
+        return;
+    }
+
+    if (allNumbers) {
+        bool allFloats = std::all_of(elements.begin(), elements.end(),
+                                     [](const Value& v) { return v.getType() == Value::Type::Float; });
+        if (allFloats) {
+            std::vector<double> keys(elements.size());
+            for (size_t i = 0; i < elements.size(); ++i) keys[i] = elements[i].getFloat();
+            sortKeys(keys, pool, parallelThreshold, lessNumber,
+                     [](std::vector<double>::iterator first, std::vector<double>::iterator last) {
+                         std::sort(first, last, lessNumber);
+                     });
+            for (size_t i = 0; i < elements.size(); ++i) elements[i] = Value(keys[i]);
+            return;
+        }
+        // Mixed integers and floats keep their own types
+        auto less = [](const Value& a, const Value& b) { return lessNumber(numericValue(a), numericValue(b)); };
+        sortKeys(elements, pool, parallelThreshold, less,
+                 [&](std::vector<Value>::iterator first, std::vector<Value>::iterator last) {
+                     std::sort(first, last, less);
+                 });
+        return;
+    }
+
+    if (allStrings) {
+        auto less = [](const Value& a, const Value& b) { return a.getString() < b.getString(); };
+        sortKeys(elements, pool, parallelThreshold, less,
+                 [&](std::vector<Value>::iterator first, std::vector<Value>::iterator last) {
+                     std::sort(first, last, less);
+                 });
+        return;
+    }
+
+    if (allBooleans) {
+        // false < true: a counting pass is enough
+        size_t falses = std::count_if(elements.begin(), elements.end(),
+                                      [](const Value& v) { return !v.getBoolean(); });
+        for (size_t i = 0; i < elements.size(); ++i) elements[i] = Value(i >= falses);
+        return;
+    }
+
+    throw std::runtime_error("sort: array elements must all be numbers, strings or booleans");
+}
+
+void sortValues(std::vector<Value>& elements, const std::function<bool(const Value&, const Value&)>& less) {
+    std::stable_sort(elements.begin(), elements.end(), less);
+}
+
+} // namespace jeve
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Value.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+namespace jeve {
+
+// Sorts array elements in place using their natural order. Integer arrays are
+// radix sorted, float and mixed numeric arrays use introsort on unboxed keys,
+// and strings are compared directly. Arrays of at least parallelThreshold
+// elements are sorted with a parallel merge sort on the given pool.
+void sortValues(std::vector<Value>& elements, ThreadPool* pool, size_t parallelThreshold);
+
+// Sorts array elements with a caller-supplied strict ordering. The sort is
+// stable, so a comparator that is not a strict weak ordering cannot corrupt
+// the array.
+void sortValues(std::vector<Value>& elements, const std::function<bool(const Value&, const Value&)>& less);
+
+// Least-significant-digit radix sort for signed 64-bit keys
+void radixSort(std::vector<int64_t>& keys);
+
+// Splits data into one chunk per pool thread, sorts the chunks concurrently
+// with sortChunk, then merges them pairwise in parallel rounds.
+template<typename T, typename Less, typename SortChunk>
+void parallelMergeSort(std::vector<T>& data, ThreadPool& pool, Less less, SortChunk sortChunk) {
+    const size_t n = data.size();
+    const size_t chunks = std::min(pool.size(), std::max<size_t>(1, n / 4096));
+    if (chunks <= 1) {
+        sortChunk(data.begin(), data.end());
+        return;
+    }
+
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t i = 0; i <= chunks; ++i) {
+        bounds[i] = n * i / chunks;
+    }
+    pool.parallelFor(chunks, [&](size_t i) {
+        sortChunk(data.begin() + bounds[i], data.begin() + bounds[i + 1]);
+    });
+
+    std::vector<T> buffer(n);
+    std::vector<T>* source = &data;
+    std::vector<T>* target = &buffer;
+    for (size_t width = 1; width < chunks; width *= 2) {
+        size_t pairs = (chunks + 2 * width - 1) / (2 * width);
+        pool.parallelFor(pairs, [&](size_t pair) {
+            size_t lo = bounds[std::min(pair * 2 * width, chunks)];
+            size_t mid = bounds[std::min(pair * 2 * width + width, chunks)];
+            size_t hi = bounds[std::min(pair * 2 * width + 2 * width, chunks)];
+            std::merge(std::make_move_iterator(source->begin() + lo), std::make_move_iterator(source->begin() + mid),
+                       std::make_move_iterator(source->begin() + mid), std::make_move_iterator(source->begin() + hi),
+                       target->begin() + lo, less);
+        });
+        std::swap(source, target);
+    }
+    if (source != &data) {
+        std::move(source->begin(), source->end(), data.begin());
+    }
+}
+
+} // namespace jeve
@@ -12,6 +12,7 @@ class SymbolTable {
 private:
     std::unordered_map<std::string, Value> symbols;
     SymbolTable* parent;
+    bool parallelFrame = false;
 
 public:
     SymbolTable(SymbolTable* p = nullptr) : parent(p) {}
@@ -24,6 +25,13 @@ public:
         symbols[name] = std::move(value);
     }
 
+    // Returns the variable's storage in this scope, creating it if needed.
+    // The reference stays valid for the lifetime of the table, so hot loops
+    // can resolve a name once and assign through the slot afterwards.
+    Value& slot(const std::string& name) {
+        return symbols[name];
+    }
+
     const Value& get(const std::string& name) const {
         auto it = symbols.find(name);
         if (it != symbols.end()) {
@@ -36,11 +44,34 @@ public:
         return empty;
     }
 
+    size_t size() const { return symbols.size(); }
+
+    // Variables of this scope only, in no particular order
+    const std::unordered_map<std::string, Value>& getSymbols() const { return symbols; }
+
     bool has(const std::string& name) const {
         return symbols.find(name) != symbols.end() || 
                (parent && parent->has(name));
     }
 
+    // Marks the frame of a parallel loop's worker. Variables found above it
+    // are shared with the loop's other threads.
+    void setParallelFrame() { parallelFrame = true; }
+
+    // Like getMutable(), and also reports whether the variable is shared
+    // with other threads of a parallel loop
+    Value& getMutable(const std::string& name, bool& shared) {
+        shared = false;
+        for (SymbolTable* table = this; table; table = table->parent) {
+            auto it = table->symbols.find(name);
+            if (it != table->symbols.end()) {
+                return it->second;
+            }
+            shared = shared || table->parallelFrame;
+        }
+        throw std::runtime_error("Variable not found: " + name);
+    }
+
     Value& getMutable(const std::string& name) {
         auto it = symbols.find(name);
         if (it != symbols.end()) {
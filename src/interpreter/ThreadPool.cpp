@@ -0,0 +1,168 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace jeve {
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : job(nullptr), jobCount(0), nextTask(0), pendingWorkers(0),
+      generation(0), busy(false), stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) threadCount = 1;
+    }
+    // The submitting thread works too, so spawn one fewer
+    for (size_t i = 1; i < threadCount; ++i) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (busy || workers.empty() || count == 1) {
+        lock.unlock();
+        for (size_t i = 0; i < count; ++i) task(i);
+        return;
+    }
+
+    busy = true;
+    job = &task;
+    jobCount = count;
+    nextTask.store(0);
+    pendingWorkers = workers.size();
+    error = nullptr;
+    ++generation;
+    lock.unlock();
+    wake.notify_all();
+
+    runTasks();
+
+    lock.lock();
+    done.wait(lock, [this]() { return pendingWorkers == 0; });
+    job = nullptr;
+    busy = false;
+    std::exception_ptr failure = error;
+    error = nullptr;
+    lock.unlock();
+
+    if (failure) std::rethrow_exception(failure);
+}
+
+void ThreadPool::parallelRange(size_t count, size_t grain,
+                               const std::function<void(size_t, size_t, size_t)>& body) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+
+    // Indices a worker has not started yet. Its owner takes chunks from the
+    // front and thieves split off the back, both under the range's lock.
+    struct alignas(64) Range {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    size_t workerCount = std::min(size(), (count + grain - 1) / grain);
+    std::vector<Range> ranges(workerCount);
+    for (size_t w = 0; w < workerCount; ++w) {
+        ranges[w].begin = count * w / workerCount;
+        ranges[w].end = count * (w + 1) / workerCount;
+    }
+    std::atomic<bool> failed(false);
+
+    // Moves the back half of the largest share into thief's empty range
+    auto steal = [&](size_t thief) {
+        while (true) {
+            size_t victim = thief;
+            size_t most = 0;
+            for (size_t w = 0; w < workerCount; ++w) {
+                std::lock_guard<std::mutex> lock(ranges[w].mutex);
+                if (ranges[w].end - ranges[w].begin > most) {
+                    most = ranges[w].end - ranges[w].begin;
+                    victim = w;
+                }
+            }
+            if (most == 0) return false;
+
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+                size_t left = ranges[victim].end - ranges[victim].begin;
+                // The victim took chunks meanwhile; look again
+                if (left == 0) continue;
+                end = ranges[victim].end;
+                begin = end - (left + 1) / 2;
+                ranges[victim].end = begin;
+            }
+            std::lock_guard<std::mutex> lock(ranges[thief].mutex);
+            ranges[thief].begin = begin;
+            ranges[thief].end = end;
+            return true;
+        }
+    };
+
+    parallelFor(workerCount, [&](size_t worker) {
+        Range& own = ranges[worker];
+        while (!failed.load(std::memory_order_relaxed)) {
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                begin = own.begin;
+                end = std::min(own.end, begin + grain);
+                own.begin = end;
+            }
+            if (begin == end) {
+                if (!steal(worker)) return;
+                continue;
+            }
+            try {
+                body(worker, begin, end);
+            } catch (...) {
+                failed.store(true, std::memory_order_relaxed);
+                throw;
+            }
+        }
+    });
+}
+
+void ThreadPool::runTasks() {
+    while (true) {
+        size_t index = nextTask.fetch_add(1);
+        if (index >= jobCount) break;
+        try {
+            (*job)(index);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) error = std::current_exception();
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        runTasks();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pendingWorkers == 0) done.notify_one();
+        }
+    }
+}
+
+} // namespace jeve
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jeve {
+
+// Fixed-size pool of worker threads used by the native builtins that split
+// work across cores. The thread that submits a job also takes part in it.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // Current job, published under the mutex
+    const std::function<void(size_t)>* job;
+    size_t jobCount;
+    std::atomic<size_t> nextTask;
+    size_t pendingWorkers;
+    uint64_t generation;
+    bool busy;
+    bool stopping;
+    std::exception_ptr error;
+
+    void workerLoop();
+    void runTasks();
+
+public:
+    // threadCount == 0 picks the number of hardware threads
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that execute a job, including the caller
+    size_t size() const { return workers.size() + 1; }
+
+    // Runs task(i) for every i in [0, count) and blocks until all are done.
+    // The first exception thrown by a task is rethrown here. Nested calls
+    // from inside a task run serially on the calling thread.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    // Runs body(worker, begin, end) over chunks of at most grain indices
+    // covering [0, count), with work stealing: every worker starts with an
+    // equal contiguous share, and one that runs dry takes the back half of
+    // the largest share left. worker is below size() and is never run by two
+    // threads at once, so per-worker state needs no locking. After a body
+    // throws, no new chunks are started and the exception is rethrown here.
+    void parallelRange(size_t count, size_t grain,
+                       const std::function<void(size_t worker, size_t begin, size_t end)>& body);
+};
+
+} // namespace jeve
@@ -11,6 +11,8 @@
 #include <variant>
 #include <mutex>
 #include <atomic>
+#include <functional>
+#include <cstdint>
 
 namespace jeve {
 
@@ -22,7 +24,8 @@ class Object;
 class ValueArray : public Object {
 private:
     std::vector<Value> elements;
-    mutable std::mutex mutex;
+    // Recursive, so a write nested in another on the same thread cannot deadlock
+    mutable std::recursive_mutex mutex;
     std::atomic<int> refCount;
     
     friend class Value; // Allow Value to access private members
@@ -33,7 +36,7 @@ public:
     explicit ValueArray(const std::vector<Value>& vals, ObjectPool* pool = nullptr) : Object(pool), elements(vals), refCount(1) {}
     
     ValueArray(const ValueArray& other) {
-        std::lock_guard<std::mutex> lock(other.mutex);
+        std::lock_guard<std::recursive_mutex> lock(other.mutex);
         elements = other.elements;
         refCount.store(1);
     }
@@ -62,8 +65,17 @@ public:
     }
     
     void push_back(const Value& value) {
+        auto lock = writeLock();
         elements.push_back(value);
     }
+
+    // Held while the elements change, so the concurrent marker never reads
+    // them halfway; locks nothing unless that marker is running
+    std::unique_lock<std::recursive_mutex> writeLock() const {
+        std::unique_lock<std::recursive_mutex> lock(mutex, std::defer_lock);
+        if (pool && pool->isMarkingConcurrently()) lock.lock();
+        return lock;
+    }
     
     // Get reference count (for Value class)
     int getRefCount() const {
@@ -76,6 +88,84 @@ public:
     std::string toString() const override {
         return "<array>";
     }
+
+    void trace(Visitor& visitor) const override;
+    size_t tracePart(Visitor& visitor, size_t begin, size_t limit) const override;
+    bool tryTracePart(Visitor& visitor, size_t begin, size_t limit, size_t& next) const override;
+    void releaseReferences() override { std::vector<Value>().swap(elements); }
+};
+
+// Associative container backed by an open-addressing hash table with Robin Hood
+// probing. Each occupied slot caches its key's hash, so probes compare hashes
+// before keys and growing the table never rehashes strings.
+class ValueMap : public Object {
+private:
+    std::vector<Value> keys;
+    std::vector<Value> values;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> distances;  // probe distance + 1, 0 marks an empty slot
+    size_t count;
+    mutable std::recursive_mutex mutex;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    size_t findSlot(const Value& key, uint64_t hash) const;
+    size_t insertNew(Value key, Value value, uint64_t hash);
+    void grow();
+
+public:
+    ValueMap(ObjectPool* pool = nullptr) : Object(pool), count(0) {}
+
+    size_t size() const { return count; }
+    size_t capacity() const { return distances.size(); }
+
+    // Slot-level access used by iteration
+    bool occupied(size_t slot) const { return distances[slot] != 0; }
+    const Value& keyAt(size_t slot) const { return keys[slot]; }
+    const Value& valueAt(size_t slot) const { return values[slot]; }
+
+    const Value* find(const Value& key) const;
+    // Both take writeLock()
+    void set(const Value& key, const Value& value);
+    bool erase(const Value& key);
+
+    // Same as ValueArray::writeLock()
+    std::unique_lock<std::recursive_mutex> writeLock() const {
+        std::unique_lock<std::recursive_mutex> lock(mutex, std::defer_lock);
+        if (pool && pool->isMarkingConcurrently()) lock.lock();
+        return lock;
+    }
+
+    std::string toString() const override {
+        return "<map>";
+    }
+
+    void trace(Visitor& visitor) const override;
+    size_t tracePart(Visitor& visitor, size_t begin, size_t limit) const override;
+    bool tryTracePart(Visitor& visitor, size_t begin, size_t limit, size_t& next) const override;
+    void releaseReferences() override;
+};
+
+// Lazy integer range produced by range(a, b, step). The end is exclusive and
+// elements are computed on demand, so iterating never materializes an array.
+struct RangeValue {
+    int64_t start;
+    int64_t end;
+    int64_t step;
+
+    size_t size() const {
+        if (step > 0 && start < end) {
+            return static_cast<size_t>((static_cast<uint64_t>(end) - static_cast<uint64_t>(start) - 1) / static_cast<uint64_t>(step) + 1);
+        }
+        if (step < 0 && start > end) {
+            return static_cast<size_t>((static_cast<uint64_t>(start) - static_cast<uint64_t>(end) - 1) / (0 - static_cast<uint64_t>(step)) + 1);
+        }
+        return 0;
+    }
+
+    int64_t at(size_t index) const {
+        return static_cast<int64_t>(static_cast<uint64_t>(start) + static_cast<uint64_t>(index) * static_cast<uint64_t>(step));
+    }
 };
 
 class Value {
@@ -86,6 +176,8 @@ public:
         Boolean,
         String,
         Array,
+        Map,
+        Range,
         Object,
         Null
     };
@@ -99,30 +191,18 @@ private:
         bool,                    // for Boolean
         std::string,             // for String
         Ref<ValueArray>,         // for Array - Ref counted
+        Ref<ValueMap>,           // for Map - Ref counted
+        RangeValue,              // for Range
         Object*                 // for Object
     >;
     
     ValueVariant data;
     Type type;
     
-    // Clean up array if needed
-    void cleanupArray() {
-        if (type == Type::Array) {
-            auto arr = std::get<Ref<ValueArray>>(data);
-            // Ref will handle cleanup
-        }
-    }
-    
     // Helper for deep copying
     void copyFrom(const Value& other) {
         type = other.type;
-        
-        if (type == Type::Array && std::holds_alternative<Ref<ValueArray>>(other.data)) {
-            auto otherArr = std::get<Ref<ValueArray>>(other.data);
-                data = otherArr;
-        } else {
-            data = other.data;
-        }
+        data = other.data;
     }
 
 public:
@@ -142,9 +222,18 @@ public:
     Value(const std::string& val) : data(val), type(Type::String) {}
     Value(const char* val) : data(std::string(val)), type(Type::String) {}
     
-    // Array constructor
+    // Array constructor. Arrays made with an interpreter's pool belong to
+    // its collector; the rest are never freed.
     Value(const std::vector<Value>& vals, ObjectPool* pool = nullptr)
-        : data(Ref<ValueArray>(new ValueArray(vals, pool))), type(Type::Array) {}
+        : data(pool ? Ref<ValueArray>(pool->getCollector()->createObject<ValueArray>(vals))
+                    : Ref<ValueArray>(new ValueArray(vals))),
+          type(Type::Array) {}
+    
+    // Map constructor
+    explicit Value(const Ref<ValueMap>& map) : data(map), type(Type::Map) {}
+    
+    // Range constructor
+    Value(const RangeValue& range) : data(range), type(Type::Range) {}
     
     // Object constructor
     Value(const Ref<Object>& obj) : data(obj.get()), type(Type::Object) {}
@@ -162,11 +251,14 @@ public:
         other.data = std::monostate();
     }
     
+    // Both assignments take the new value before dropping the old one: the
+    // old one may hold the last reference to the container other lives in
+    
     // Copy assignment
     Value& operator=(const Value& other) {
         if (this != &other) {
-            cleanupArray();
-            copyFrom(other);
+            Value copy(other);
+            *this = std::move(copy);
         }
         return *this;
     }
@@ -174,20 +266,16 @@ public:
     // Move assignment
     Value& operator=(Value&& other) noexcept {
         if (this != &other) {
-            cleanupArray();
-            type = other.type;
-            data = std::move(other.data);
+            ValueVariant incoming = std::move(other.data);
+            Type incomingType = other.type;
             other.type = Type::Null;
             other.data = std::monostate();
+            data = std::move(incoming);
+            type = incomingType;
         }
         return *this;
     }
     
-    // Destructor
-    ~Value() {
-        cleanupArray();
-    }
-    
     // Type inspection
     Type getType() const { return type; }
     bool isNull() const { return type == Type::Null; }
@@ -216,10 +304,10 @@ public:
     }
     
     // Ensure the array is unique before modification (copy-on-write)
-    Ref<ValueArray> prepareArrayForModification() {
+    ValueArray* prepareArrayForModification() {
         if (type != Type::Array) throw std::runtime_error("Value is not an array");
         
-        auto arr = std::get<Ref<ValueArray>>(data);
+        const auto& arr = std::get<Ref<ValueArray>>(data);
         if (!arr) throw std::runtime_error("Null array value");
         
         // If refCount > 1, create a new copy
@@ -227,10 +315,10 @@ public:
             Ref<ValueArray> newArr = Ref<ValueArray>(new ValueArray(*arr));
             arr->release();
             data = newArr;
-            return newArr;
+            return newArr.get();
         }
         
-        return arr;
+        return arr.get();
     }
     
     // Array access - mutable
@@ -242,12 +330,56 @@ public:
     const std::vector<Value>& getArray() const {
         if (type != Type::Array) throw std::runtime_error("Value is not an array");
         
-        auto arr = std::get<Ref<ValueArray>>(data);
+        const auto& arr = std::get<Ref<ValueArray>>(data);
         if (!arr) throw std::runtime_error("Null array value");
         
         return arr->getElements();
     }
     
+    // Shared handle to the underlying array, without copy-on-write
+    Ref<ValueArray> getArrayObject() const {
+        if (type != Type::Array) throw std::runtime_error("Value is not an array");
+        return std::get<Ref<ValueArray>>(data);
+    }
+    
+    Ref<ValueMap> getMap() const {
+        if (type != Type::Map) throw std::runtime_error("Value is not a map");
+        return std::get<Ref<ValueMap>>(data);
+    }
+    
+    // Hash and equality used for map keys. Only scalar values can be keys.
+    uint64_t hash() const {
+        uint64_t h;
+        switch (type) {
+            case Type::Integer: h = static_cast<uint64_t>(std::get<int64_t>(data)); break;
+            case Type::Float: h = std::hash<double>()(std::get<double>(data)); break;
+            case Type::Boolean: h = std::get<bool>(data) ? 1 : 0; break;
+            case Type::String: h = std::hash<std::string>()(std::get<std::string>(data)); break;
+            default: throw std::runtime_error("Map keys must be integers, floats, booleans or strings");
+        }
+        // Mix the type in and spread the bits (splitmix64 finalizer)
+        h ^= static_cast<uint64_t>(type) * 0x9e3779b97f4a7c15ULL;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+    
+    bool keyEquals(const Value& other) const {
+        if (type != other.type) return false;
+        switch (type) {
+            case Type::Integer: return std::get<int64_t>(data) == std::get<int64_t>(other.data);
+            case Type::Float: return std::get<double>(data) == std::get<double>(other.data);
+            case Type::Boolean: return std::get<bool>(data) == std::get<bool>(other.data);
+            case Type::String: return std::get<std::string>(data) == std::get<std::string>(other.data);
+            default: return false;
+        }
+    }
+    
+    const RangeValue& getRange() const {
+        if (type != Type::Range) throw std::runtime_error("Value is not a range");
+        return std::get<RangeValue>(data);
+    }
+    
     // Array element access with bounds checking
     Value& at(size_t index) {
         auto arr = prepareArrayForModification();
@@ -260,7 +392,7 @@ public:
     const Value& at(size_t index) const {
         if (type != Type::Array) throw std::runtime_error("Value is not an array");
         
-        auto arr = std::get<Ref<ValueArray>>(data);
+        const auto& arr = std::get<Ref<ValueArray>>(data);
         if (!arr) throw std::runtime_error("Null array value");
         
         if (index >= arr->size()) {
@@ -290,7 +422,7 @@ public:
             case Type::Array: {
                 if (type != Type::Array) return "null";
                 
-                auto arr = std::get<Ref<ValueArray>>(data);
+                const auto& arr = std::get<Ref<ValueArray>>(data);
                 if (!arr) return "null";
                 
                 const auto& elements = arr->getElements();
@@ -309,6 +441,32 @@ public:
                 oss << "]";
                 break;
             }
+            case Type::Map: {
+                const auto& map = std::get<Ref<ValueMap>>(data);
+                if (!map) return "null";
+                
+                oss << "{";
+                bool first = true;
+                for (size_t slot = 0; slot < map->capacity(); ++slot) {
+                    if (!map->occupied(slot)) continue;
+                    if (!first) oss << ", ";
+                    first = false;
+                    const Value& element = map->valueAt(slot);
+                    oss << map->keyAt(slot).toString() << ": ";
+                    if (element.getType() == Type::Array || element.getType() == Type::Map) {
+                        oss << "{...}"; // Avoid recursion for nested containers
+                    } else {
+                        oss << element.toString();
+                    }
+                }
+                oss << "}";
+                break;
+            }
+            case Type::Range: {
+                const auto& range = getRange();
+                oss << "range(" << range.start << ", " << range.end << ", " << range.step << ")";
+                break;
+            }
             case Type::Object:
                 oss << "<object>";
                 break;
@@ -342,9 +500,15 @@ public:
             case Type::String:
                 return !std::get<std::string>(data).empty();
             case Type::Array: {
-                auto arr = std::get<Ref<ValueArray>>(data);
+                const auto& arr = std::get<Ref<ValueArray>>(data);
                 return arr && !arr->getElements().empty();
             }
+            case Type::Map: {
+                const auto& map = std::get<Ref<ValueMap>>(data);
+                return map && map->size() > 0;
+            }
+            case Type::Range:
+                return std::get<RangeValue>(data).size() > 0;
             default:
                 return false;
         }
@@ -354,6 +518,16 @@ public:
         if (type != Type::Object) throw std::runtime_error("Value is not an object");
         return std::get<Object*>(data);
     }
+
+    // Visits the array or map this value refers to. Functions are not
+    // visited: they live in a program arena, not on the heap.
+    void trace(Visitor& visitor) const {
+        if (type == Type::Array) {
+            visitor.visit(std::get<Ref<ValueArray>>(data).get());
+        } else if (type == Type::Map) {
+            visitor.visit(std::get<Ref<ValueMap>>(data).get());
+        }
+    }
 };
 
 // Now we can define these methods that needed the full Value definition
@@ -371,4 +545,157 @@ inline const Value& ValueArray::at(size_t index) const {
     return elements[index];
 }
 
-} // namespace jeve 
\ No newline at end of file
+inline void ValueArray::trace(Visitor& visitor) const {
+    for (const Value& element : elements) {
+        element.trace(visitor);
+    }
+}
+
+inline size_t ValueArray::tracePart(Visitor& visitor, size_t begin, size_t limit) const {
+    size_t end = std::min(elements.size(), begin + limit);
+    for (size_t i = begin; i < end; ++i) {
+        elements[i].trace(visitor);
+    }
+    return end < elements.size() ? end : 0;
+}
+
+inline bool ValueArray::tryTracePart(Visitor& visitor, size_t begin, size_t limit, size_t& next) const {
+    std::unique_lock<std::recursive_mutex> lock(mutex, std::try_to_lock);
+    if (!lock) return false;
+    next = tracePart(visitor, begin, limit);
+    return true;
+}
+
+inline void ValueMap::trace(Visitor& visitor) const {
+    // Keys are always scalars
+    for (size_t slot = 0; slot < values.size(); ++slot) {
+        values[slot].trace(visitor);
+    }
+}
+
+inline size_t ValueMap::tracePart(Visitor& visitor, size_t begin, size_t limit) const {
+    size_t end = std::min(values.size(), begin + limit);
+    for (size_t slot = begin; slot < end; ++slot) {
+        values[slot].trace(visitor);
+    }
+    return end < values.size() ? end : 0;
+}
+
+inline bool ValueMap::tryTracePart(Visitor& visitor, size_t begin, size_t limit, size_t& next) const {
+    std::unique_lock<std::recursive_mutex> lock(mutex, std::try_to_lock);
+    if (!lock) return false;
+    next = tracePart(visitor, begin, limit);
+    return true;
+}
+
+inline void ValueMap::releaseReferences() {
+    std::vector<Value>().swap(keys);
+    std::vector<Value>().swap(values);
+    std::vector<uint64_t>().swap(hashes);
+    std::vector<uint32_t>().swap(distances);
+    count = 0;
+}
+
+inline size_t ValueMap::findSlot(const Value& key, uint64_t hash) const {
+    if (distances.empty()) return npos;
+    size_t mask = distances.size() - 1;
+    size_t pos = hash & mask;
+    // Robin Hood invariant: once our probe distance exceeds the resident's, the key is absent
+    for (uint32_t dist = 1; distances[pos] >= dist; ++dist) {
+        if (hashes[pos] == hash && keys[pos].keyEquals(key)) {
+            return pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return npos;
+}
+
+inline size_t ValueMap::insertNew(Value key, Value value, uint64_t hash) {
+    size_t mask = distances.size() - 1;
+    size_t pos = hash & mask;
+    size_t placed = npos;
+    uint32_t dist = 1;
+    while (true) {
+        if (distances[pos] == 0) {
+            keys[pos] = std::move(key);
+            values[pos] = std::move(value);
+            hashes[pos] = hash;
+            distances[pos] = dist;
+            ++count;
+            return placed == npos ? pos : placed;
+        }
+        if (distances[pos] < dist) {
+            // Take the slot from the richer resident and keep inserting it instead
+            std::swap(keys[pos], key);
+            std::swap(values[pos], value);
+            std::swap(hashes[pos], hash);
+            std::swap(distances[pos], dist);
+            if (placed == npos) placed = pos;
+        }
+        pos = (pos + 1) & mask;
+        ++dist;
+    }
+}
+
+inline void ValueMap::grow() {
+    size_t newCapacity = distances.empty() ? 8 : distances.size() * 2;
+    std::vector<Value> oldKeys(newCapacity);
+    std::vector<Value> oldValues(newCapacity);
+    std::vector<uint64_t> oldHashes(newCapacity, 0);
+    std::vector<uint32_t> oldDistances(newCapacity, 0);
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+    oldHashes.swap(hashes);
+    oldDistances.swap(distances);
+    count = 0;
+    // Cached hashes make rehashing independent of key type and length
+    for (size_t slot = 0; slot < oldDistances.size(); ++slot) {
+        if (oldDistances[slot] != 0) {
+            insertNew(std::move(oldKeys[slot]), std::move(oldValues[slot]), oldHashes[slot]);
+        }
+    }
+}
+
+inline const Value* ValueMap::find(const Value& key) const {
+    size_t slot = findSlot(key, key.hash());
+    return slot == npos ? nullptr : &values[slot];
+}
+
+inline void ValueMap::set(const Value& key, const Value& value) {
+    auto lock = writeLock();
+    uint64_t hash = key.hash();
+    size_t slot = findSlot(key, hash);
+    if (slot != npos) {
+        values[slot] = value;
+        return;
+    }
+    // Keep the load factor below 85% so probe sequences stay short
+    if ((count + 1) * 20 > distances.size() * 17) {
+        grow();
+    }
+    insertNew(key, value, hash);
+}
+
+inline bool ValueMap::erase(const Value& key) {
+    auto lock = writeLock();
+    size_t slot = findSlot(key, key.hash());
+    if (slot == npos) return false;
+    // Backward-shift deletion keeps the table tombstone-free
+    size_t mask = distances.size() - 1;
+    size_t next = (slot + 1) & mask;
+    while (distances[next] > 1) {
+        keys[slot] = std::move(keys[next]);
+        values[slot] = std::move(values[next]);
+        hashes[slot] = hashes[next];
+        distances[slot] = distances[next] - 1;
+        slot = next;
+        next = (next + 1) & mask;
+    }
+    keys[slot] = Value();
+    values[slot] = Value();
+    distances[slot] = 0;
+    --count;
+    return true;
+}
+
+} // namespace jeve
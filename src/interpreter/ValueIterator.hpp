@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Value.hpp"
+#include <stdexcept>
+
+namespace jeve {
+
+// Iterator protocol shared by every iterable value. The iterator walks the
+// source in place (arrays by index, maps by slot, ranges arithmetically) and
+// writes each key/value pair straight into caller-provided slots, so a loop
+// never copies or materializes the collection it walks.
+class ValueIterator {
+private:
+    Value::Type kind;
+    Ref<ValueArray> array;   // keeps the array alive if the loop reassigns its variable
+    Ref<ValueMap> map;
+    RangeValue range{0, 0, 1};
+    size_t position;
+    size_t count;
+
+public:
+    explicit ValueIterator(const Value& iterable) : kind(iterable.getType()), position(0), count(0) {
+        switch (kind) {
+            case Value::Type::Array:
+                array = iterable.getArrayObject();
+                break;
+            case Value::Type::Map:
+                map = iterable.getMap();
+                break;
+            case Value::Type::Range:
+                range = iterable.getRange();
+                count = range.size();
+                break;
+            default:
+                throw std::runtime_error("Cannot iterate over non-iterable value");
+        }
+    }
+
+    // Advances to the next element. Returns false once the source is exhausted.
+    bool next(Value& keySlot, Value& valueSlot) {
+        if (kind == Value::Type::Range) {
+            if (position >= count) return false;
+            keySlot = Value(static_cast<int64_t>(position));
+            valueSlot = Value(range.at(position));
+            ++position;
+            return true;
+        }
+
+        if (kind == Value::Type::Map) {
+            // Maps yield key/value pairs in slot order
+            while (position < map->capacity() && !map->occupied(position)) ++position;
+            if (position >= map->capacity()) return false;
+            keySlot = map->keyAt(position);
+            valueSlot = map->valueAt(position);
+            ++position;
+            return true;
+        }
+
+        // Arrays may shrink or grow inside the loop body, so re-check every step
+        const auto& elements = array->getElements();
+        if (position >= elements.size()) return false;
+        keySlot = Value(static_cast<int64_t>(position));
+        valueSlot = elements[position];
+        ++position;
+        return true;
+    }
+};
+
+} // namespace jeve
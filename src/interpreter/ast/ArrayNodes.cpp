@@ -13,16 +13,17 @@
 
 namespace jeve {
 
+namespace {
+
+const char* const SHARED_MAP_ERROR = "Cannot modify a map created outside parallel code";
+
+} // namespace
+
 Value ArrayNode::evaluate(SymbolTable& scope) {
     std::vector<Value> result;
     for (const auto& elem : elements) {
         result.push_back(elem->evaluate(scope));
     }
-    // Get the GC from the scope (assume scope has a getGC or pass it in)
-    // For now, use global GC if available, or refactor as needed
-    // This is a placeholder; you may need to pass the GC or ObjectPool explicitly
-    extern jeve::GarbageCollector* g_jeve_gc;
-    ObjectPool* pool = g_jeve_gc ? g_jeve_gc->getObjectPool() : nullptr;
     return Value(result, pool);
 }
 
@@ -30,7 +31,15 @@ Value ArrayAccessNode::evaluate(SymbolTable& scope) {
     Value arr = array->evaluate(scope);
     Value idx = index->evaluate(scope);
     
-    if (arr.getType() != Value::Type::Array) {
+    if (arr.getType() == Value::Type::Map) {
+        const Value* found = arr.getMap()->find(idx);
+        if (!found) {
+            throw std::runtime_error("Key not found in map: " + idx.toString());
+        }
+        return *found;
+    }
+    
+    if (arr.getType() != Value::Type::Array && arr.getType() != Value::Type::Range) {
         throw std::runtime_error("Cannot index into non-array value");
     }
     
@@ -39,6 +48,14 @@ Value ArrayAccessNode::evaluate(SymbolTable& scope) {
     }
     
     int64_t index = idx.getInteger();
+    if (arr.getType() == Value::Type::Range) {
+        const auto& range = arr.getRange();
+        if (index < 0 || static_cast<size_t>(index) >= range.size()) {
+            throw std::runtime_error("Array index out of bounds");
+        }
+        return Value(range.at(static_cast<size_t>(index)));
+    }
+    
     const auto& elements = arr.getArray();
     
     if (index < 0 || static_cast<size_t>(index) >= elements.size()) {
@@ -50,10 +67,19 @@ Value ArrayAccessNode::evaluate(SymbolTable& scope) {
 
 Value ArrayAssignmentNode::evaluate(SymbolTable& scope) {
     // Try to update the array in the symbol table if possible
-    if (auto* idNode = dynamic_cast<IdentifierNode*>(array.get())) {
-        Value& arrRef = scope.getMutable(idNode->getName());
+    if (auto* idNode = dynamic_cast<IdentifierNode*>(array)) {
+        bool shared;
+        Value& arrRef = scope.getMutable(idNode->getName(), shared);
         Value idx = index->evaluate(scope);
         Value val = value->evaluate(scope);
+        if (arrRef.getType() == Value::Type::Map) {
+            // Workers of a parallel loop may only write distinct array elements
+            if (shared) throw std::runtime_error("Cannot modify map '" + idNode->getName() + "' inside parallel code");
+            Ref<ValueMap> map = arrRef.getMap();
+            if (AllocationBuffer::isShared(map.get())) throw std::runtime_error(SHARED_MAP_ERROR);
+            map->set(idx, val);
+            return val;
+        }
         if (arrRef.getType() != Value::Type::Array) {
             throw std::runtime_error("Cannot index into non-array value");
         }
@@ -61,40 +87,25 @@ Value ArrayAssignmentNode::evaluate(SymbolTable& scope) {
             throw std::runtime_error("Array index must be an integer");
         }
         int64_t indexVal = idx.getInteger();
-        auto& elements = arrRef.getArray();
+        ValueArray* target = arrRef.prepareArrayForModification();
+        auto lock = target->writeLock();
+        auto& elements = target->getElements();
         if (indexVal < 0 || static_cast<size_t>(indexVal) >= elements.size()) {
             throw std::runtime_error("Array index out of bounds");
         }
-        if (interpreter) {
-            switch (val.getType()) {
-                case Value::Type::Integer:
-                    elements[indexVal] = Value(Ref<Object>(interpreter->createObject<NumberNode>(val.getInteger())));
-                    break;
-                case Value::Type::Float:
-                    elements[indexVal] = Value(Ref<Object>(interpreter->createObject<NumberNode>(val.getFloat())));
-                    break;
-                case Value::Type::String:
-                    elements[indexVal] = Value(Ref<Object>(interpreter->createObject<StringNode>(val.getString())));
-                    break;
-                case Value::Type::Boolean:
-                    elements[indexVal] = Value(Ref<Object>(interpreter->createObject<BooleanNode>(val.getBoolean())));
-                    break;
-                case Value::Type::Array:
-                    elements[indexVal] = val; // Arrays are already GC-managed
-                    break;
-                default:
-                    elements[indexVal] = val;
-                    break;
-            }
-        } else {
-            elements[indexVal] = val;
-        }
+        elements[indexVal] = val;
         return val;
     }
     // Fallback: evaluate as before (for arr[0][1] = x, etc.)
     Value arr = array->evaluate(scope);
     Value idx = index->evaluate(scope);
     Value val = value->evaluate(scope);
+    if (arr.getType() == Value::Type::Map) {
+        Ref<ValueMap> map = arr.getMap();
+        if (AllocationBuffer::isShared(map.get())) throw std::runtime_error(SHARED_MAP_ERROR);
+        map->set(idx, val);
+        return val;
+    }
     if (arr.getType() != Value::Type::Array) {
         throw std::runtime_error("Cannot index into non-array value");
     }
@@ -102,34 +113,13 @@ Value ArrayAssignmentNode::evaluate(SymbolTable& scope) {
         throw std::runtime_error("Array index must be an integer");
     }
     int64_t indexVal = idx.getInteger();
-    auto& elements = arr.getArray();
+    ValueArray* target = arr.prepareArrayForModification();
+    auto lock = target->writeLock();
+    auto& elements = target->getElements();
     if (indexVal < 0 || static_cast<size_t>(indexVal) >= elements.size()) {
         throw std::runtime_error("Array index out of bounds");
     }
-    if (interpreter) {
-        switch (val.getType()) {
-            case Value::Type::Integer:
-                elements[indexVal] = Value(Ref<Object>(interpreter->createObject<NumberNode>(val.getInteger())));
-                break;
-            case Value::Type::Float:
-                elements[indexVal] = Value(Ref<Object>(interpreter->createObject<NumberNode>(val.getFloat())));
-                break;
-            case Value::Type::String:
-                elements[indexVal] = Value(Ref<Object>(interpreter->createObject<StringNode>(val.getString())));
-                break;
-            case Value::Type::Boolean:
-                elements[indexVal] = Value(Ref<Object>(interpreter->createObject<BooleanNode>(val.getBoolean())));
-                break;
-            case Value::Type::Array:
-                elements[indexVal] = val; // Arrays are already GC-managed
-                break;
-            default:
-                elements[indexVal] = val;
-                break;
-        }
-    } else {
-        elements[indexVal] = val;
-    }
+    elements[indexVal] = val;
     return val;
 }
 
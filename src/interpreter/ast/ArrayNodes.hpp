@@ -2,6 +2,7 @@
 
 #include "../ASTNode.hpp"
 #include "../Forward.hpp"
+#include <utility>
 #include <vector>
 
 namespace jeve {
@@ -10,40 +11,55 @@ class JeveInterpreter;
 
 class ArrayNode : public ASTNode {
 private:
-    std::vector<Ref<ASTNode>> elements;
+    std::vector<ASTNode*> elements;
+    ObjectPool* pool;  // of the interpreter that owns the program
 
 public:
-    ArrayNode(const std::vector<Ref<ASTNode>>& elems) : elements(elems) {}
+    ArrayNode(std::vector<ASTNode*> elems, ObjectPool* p = nullptr) : elements(std::move(elems)), pool(p) {}
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "ArrayNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Array);
+        out.nodes(elements);
+    }
 };
 
 class ArrayAccessNode : public ASTNode {
 private:
-    Ref<ASTNode> array;
-    Ref<ASTNode> index;
+    ASTNode* array;
+    ASTNode* index;
 
 public:
-    ArrayAccessNode(Ref<ASTNode> arr, Ref<ASTNode> idx) : array(arr), index(idx) {}
+    ArrayAccessNode(ASTNode* arr, ASTNode* idx) : array(arr), index(idx) {}
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "ArrayAccessNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::ArrayAccess);
+        out.node(array);
+        out.node(index);
+    }
 };
 
 class ArrayAssignmentNode : public ASTNode {
 private:
-    Ref<ASTNode> array;
-    Ref<ASTNode> index;
-    Ref<ASTNode> value;
-    JeveInterpreter* interpreter;
+    ASTNode* array;
+    ASTNode* index;
+    ASTNode* value;
 
 public:
-    ArrayAssignmentNode(Ref<ASTNode> arr, Ref<ASTNode> idx, Ref<ASTNode> val, JeveInterpreter* interp = nullptr) 
-        : array(arr), index(idx), value(val), interpreter(interp) {}
+    ArrayAssignmentNode(ASTNode* arr, ASTNode* idx, ASTNode* val) 
+        : array(arr), index(idx), value(val) {}
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "ArrayAssignmentNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::ArrayAssignment);
+        out.node(array);
+        out.node(index);
+        out.node(value);
+    }
 };
 
 // Note: Arrays are now GC-managed and allocated via the ObjectPool.
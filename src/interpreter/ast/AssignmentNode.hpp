@@ -8,11 +8,11 @@ namespace jeve {
 class AssignmentNode : public ASTNode {
 private:
     std::string name;
-    Ref<ASTNode> value;
+    ASTNode* value;
     std::string type;
 
 public:
-    AssignmentNode(const std::string& name, Ref<ASTNode> value, const std::string& type = "")
+    AssignmentNode(const std::string& name, ASTNode* value, const std::string& type = "")
         : name(name), value(value), type(type) {}
 
     Value evaluate(SymbolTable& scope) override {
@@ -22,6 +22,12 @@ public:
     }
 
     std::string toString() const override { return "AssignmentNode(" + name + ")"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Assignment);
+        out.string(name);
+        out.string(type);
+        out.node(value);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
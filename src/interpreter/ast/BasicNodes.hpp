@@ -11,10 +11,15 @@ private:
 
 public:
     NumberNode(int64_t val) : value(val) {}
+    int64_t getValue() const { return value; }
     Value evaluate(SymbolTable&) override {
         return Value(value);
     }
     std::string toString() const override { return "NumberNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Number);
+        out.i64(value);
+    }
 };
 
 class StringNode : public ASTNode {
@@ -27,6 +32,10 @@ public:
         return Value(value);
     }
     std::string toString() const override { return "StringNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::String);
+        out.string(value);
+    }
 };
 
 class IdentifierNode : public ASTNode {
@@ -41,6 +50,10 @@ public:
 
     const std::string& getName() const { return name; }
     std::string toString() const override { return "IdentifierNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Identifier);
+        out.string(name);
+    }
 };
 
 class BooleanNode : public ASTNode {
@@ -55,6 +68,10 @@ public:
     }
 
     std::string toString() const override { return "BooleanNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Boolean);
+        out.u8(value ? 1 : 0);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
@@ -7,11 +7,11 @@ namespace jeve {
 
 class ConcatNode : public ASTNode {
 private:
-    Ref<ASTNode> left;
-    Ref<ASTNode> right;
+    ASTNode* left;
+    ASTNode* right;
 
 public:
-    ConcatNode(Ref<ASTNode> left, Ref<ASTNode> right)
+    ConcatNode(ASTNode* left, ASTNode* right)
         : left(left), right(right) {}
 
     Value evaluate(SymbolTable& scope) override {
@@ -24,6 +24,11 @@ public:
     }
 
     std::string toString() const override { return "ConcatNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Concat);
+        out.node(left);
+        out.node(right);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
@@ -1,42 +1,28 @@
 #include "ControlFlowNodes.hpp"
+#include "OperatorNodes.hpp"
+#include "../JeveInterpreter.hpp"
+#include <memory>
 
 namespace jeve {
 
-Value StatementNode::evaluate(SymbolTable& scope) {
-    try {
-        Value result = statement->evaluate(scope);
-        if (next.get()) result = next->evaluate(scope);
-        return result;
-    } catch (const ReturnException&) {
-        throw;
-    }
-}
-
-void BlockNode::addStatement(Ref<ASTNode> stmt) {
-    Ref<StatementNode> node(new StatementNode(stmt, gc));
-    if (!first.get()) {
-        first = node;
-        last = node;
-    } else {
-        last->setNext(node);
-        last = node;
-    }
+void BlockNode::addStatement(ASTNode* stmt) {
+    // Function definitions parse to no statement at all
+    if (stmt) statements.push_back(stmt);
 }
 
 Value BlockNode::evaluate(SymbolTable& scope) {
-    if (!first.get()) return Value();
-    try {
-        return first->evaluate(scope);
-    } catch (const ReturnException&) {
-        throw;
+    Value result;
+    for (ASTNode* stmt : statements) {
+        result = stmt->evaluate(scope);
     }
+    return result;
 }
 
 Value IfNode::evaluate(SymbolTable& scope) {
     Value cond = condition->evaluate(scope);
     if (cond.toBoolean()) {
         return thenBlock->evaluate(scope);
-    } else if (elseBlock.get()) {
+    } else if (elseBlock) {
         return elseBlock->evaluate(scope);
     }
     return Value();
@@ -49,6 +35,7 @@ Value WhileNode::evaluate(SymbolTable& scope) {
         if (cond.getType() != Value::Type::Boolean) throw std::runtime_error("Condition must be a boolean");
         if (!cond.getBoolean()) break;
         result = body->evaluate(scope);
+        Safepoint::poll();
     }
     return result;
 }
@@ -56,7 +43,7 @@ Value WhileNode::evaluate(SymbolTable& scope) {
 Value ForNode::evaluate(SymbolTable& scope) {
     Value startVal = start->evaluate(scope);
     Value endVal = end->evaluate(scope);
-    Value stepVal = step.get() ? step->evaluate(scope) : Value(int64_t(1));
+    Value stepVal = step ? step->evaluate(scope) : Value(int64_t(1));
     if (startVal.getType() != Value::Type::Integer || endVal.getType() != Value::Type::Integer || stepVal.getType() != Value::Type::Integer)
         throw std::runtime_error("For loop requires integer values");
     int64_t s = startVal.getInteger(), e = endVal.getInteger(), st = stepVal.getInteger();
@@ -66,14 +53,84 @@ Value ForNode::evaluate(SymbolTable& scope) {
         for (int64_t i = s; i <= e; i += st) {
             scope.set(varName, Value(i));
             result = body->evaluate(scope);
+            Safepoint::poll();
         }
     } else {
         for (int64_t i = s; i >= e; i += st) {
             scope.set(varName, Value(i));
             result = body->evaluate(scope);
+            Safepoint::poll();
         }
     }
     return result;
 }
 
-} // namespace jeve 
\ No newline at end of file
+Value ParallelForNode::evaluate(SymbolTable& scope) {
+    Value startVal = start->evaluate(scope);
+    Value endVal = end->evaluate(scope);
+    Value stepVal = step ? step->evaluate(scope) : Value(int64_t(1));
+    if (startVal.getType() != Value::Type::Integer || endVal.getType() != Value::Type::Integer || stepVal.getType() != Value::Type::Integer)
+        throw std::runtime_error("For loop requires integer values");
+    int64_t s = startVal.getInteger(), e = endVal.getInteger(), st = stepVal.getInteger();
+    if (st == 0) throw std::runtime_error("For loop step cannot be zero");
+    // Same iterations as ForNode: s, s + st, ... up to and including e
+    size_t count = 0;
+    if (st > 0 && s <= e) {
+        count = static_cast<size_t>((static_cast<uint64_t>(e) - static_cast<uint64_t>(s)) / static_cast<uint64_t>(st) + 1);
+    } else if (st < 0 && s >= e) {
+        count = static_cast<size_t>((static_cast<uint64_t>(s) - static_cast<uint64_t>(e)) / (0 - static_cast<uint64_t>(st)) + 1);
+    }
+    for (const ReductionVariable& reduction : reductions) {
+        if (!scope.has(reduction.name)) {
+            throw std::runtime_error("Reduction variable '" + reduction.name + "' must be set before the parallel for");
+        }
+    }
+
+    struct Worker {
+        std::unique_ptr<SymbolTable> frame;
+        Value* index = nullptr;
+    };
+    std::vector<Worker> workers(interpreter->getThreadPool().size());
+    interpreter->runParallel(count, [&](size_t w, size_t first, size_t last) {
+        Worker& worker = workers[w];
+        if (!worker.frame) {
+            worker.frame = std::make_unique<SymbolTable>(&scope);
+            worker.frame->setParallelFrame();
+            for (const ReductionVariable& reduction : reductions) {
+                worker.frame->set(reduction.name, reduction.op == Reduction::Sum ? Value(int64_t(0)) : scope.get(reduction.name));
+            }
+            worker.index = &worker.frame->slot(varName);
+        }
+        for (size_t i = first; i < last; ++i) {
+            *worker.index = Value(static_cast<int64_t>(static_cast<uint64_t>(s) + static_cast<uint64_t>(i) * static_cast<uint64_t>(st)));
+            try {
+                body->evaluate(*worker.frame);
+            } catch (const ReturnException&) {
+                throw std::runtime_error("return is not allowed inside a parallel for");
+            }
+        }
+    });
+
+    for (const ReductionVariable& reduction : reductions) {
+        Value total = scope.get(reduction.name);
+        for (const Worker& worker : workers) {
+            if (!worker.frame) continue;
+            const Value& part = worker.frame->get(reduction.name);
+            switch (reduction.op) {
+                case Reduction::Sum:
+                    total = applyBinaryOperator(BinaryOperator::Add, total, part);
+                    break;
+                case Reduction::Min:
+                    if (applyBinaryOperator(BinaryOperator::Less, part, total).toBoolean()) total = part;
+                    break;
+                case Reduction::Max:
+                    if (applyBinaryOperator(BinaryOperator::Greater, part, total).toBoolean()) total = part;
+                    break;
+            }
+        }
+        scope.set(reduction.name, std::move(total));
+    }
+    return Value();
+}
+
+} // namespace jeve
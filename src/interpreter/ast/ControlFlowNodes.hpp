@@ -1,64 +1,123 @@
 #pragma once
 
 #include "../ASTNode.hpp"
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace jeve {
 
-class StatementNode : public ASTNode {
-    Ref<ASTNode> statement;
-    Ref<StatementNode> next;
-    GarbageCollector* gc;
-public:
-    StatementNode(Ref<ASTNode> stmt, GarbageCollector* g) : statement(stmt), next(), gc(g) {}
-    void setNext(Ref<StatementNode> n) { next = n; }
-    ASTNode* getStatement() const { return statement.get(); }
-    StatementNode* getNext() const { return next.get(); }
-    Value evaluate(SymbolTable& scope) override;
-    GarbageCollector* getGC() const { return gc; }
-    std::string toString() const override { return "StatementNode"; }
-};
+class JeveInterpreter;
 
 class BlockNode : public ASTNode {
-    Ref<StatementNode> first;
-    Ref<StatementNode> last;
-    GarbageCollector* gc;
+    std::vector<ASTNode*> statements;
 public:
-    BlockNode(GarbageCollector* g) : first(), last(), gc(g) {}
-    void addStatement(Ref<ASTNode> stmt);
+    BlockNode() = default;
+    void addStatement(ASTNode* stmt);
+    const std::vector<ASTNode*>& getStatements() const { return statements; }
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "BlockNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Block);
+        out.nodes(statements);
+    }
 };
 
 class IfNode : public ASTNode {
-    Ref<ASTNode> condition;
-    Ref<BlockNode> thenBlock;
-    Ref<BlockNode> elseBlock;
+    ASTNode* condition;
+    BlockNode* thenBlock;
+    BlockNode* elseBlock;
 public:
-    IfNode(Ref<ASTNode> cond, Ref<BlockNode> then, Ref<BlockNode> else_ = Ref<BlockNode>())
+    IfNode(ASTNode* cond, BlockNode* then, BlockNode* else_ = nullptr)
         : condition(cond), thenBlock(then), elseBlock(else_) {}
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "IfNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::If);
+        out.node(condition);
+        out.node(thenBlock);
+        out.node(elseBlock);
+    }
 };
 
 class WhileNode : public ASTNode {
-    Ref<ASTNode> condition;
-    Ref<BlockNode> body;
+    ASTNode* condition;
+    BlockNode* body;
 public:
-    WhileNode(Ref<ASTNode> cond, Ref<BlockNode> b) : condition(cond), body(b) {}
+    WhileNode(ASTNode* cond, BlockNode* b) : condition(cond), body(b) {}
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "WhileNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::While);
+        out.node(condition);
+        out.node(body);
+    }
 };
 
 class ForNode : public ASTNode {
     std::string varName;
-    Ref<ASTNode> start, end, step;
-    Ref<BlockNode> body;
+    ASTNode *start, *end, *step;
+    BlockNode* body;
 public:
-    ForNode(const std::string& var, Ref<ASTNode> s, Ref<ASTNode> e, Ref<ASTNode> st, Ref<BlockNode> b)
+    ForNode(const std::string& var, ASTNode* s, ASTNode* e, ASTNode* st, BlockNode* b)
         : varName(var), start(s), end(e), step(st), body(b) {}
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "ForNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::For);
+        out.string(varName);
+        out.node(start);
+        out.node(end);
+        out.node(step);
+        out.node(body);
+    }
+};
+
+// How the workers' copies of a reduction variable are combined
+enum class Reduction : uint8_t {
+    Sum,
+    Min,
+    Max
+};
+
+struct ReductionVariable {
+    Reduction op;
+    std::string name;
+};
+
+// parallel for i = a to b step s reduce(sum: total, max: best) { ... }
+// Iterations are split across the interpreter's thread pool. Each worker
+// runs in a frame of its own, so the loop variable and anything the body
+// assigns are private to it and gone after the loop. Results leave through
+// elements of outer arrays, which iterations must write at distinct
+// indices, and through reduction variables: each worker starts from the
+// variable's value (0 for sum) and the copies are merged into it at the end.
+class ParallelForNode : public ASTNode {
+    std::string varName;
+    ASTNode *start, *end, *step;
+    BlockNode* body;
+    std::vector<ReductionVariable> reductions;
+    JeveInterpreter* interpreter;
+public:
+    ParallelForNode(const std::string& var, ASTNode* s, ASTNode* e, ASTNode* st, BlockNode* b,
+                    std::vector<ReductionVariable> r, JeveInterpreter* interp)
+        : varName(var), start(s), end(e), step(st), body(b), reductions(std::move(r)), interpreter(interp) {}
+    Value evaluate(SymbolTable& scope) override;
+    std::string toString() const override { return "ParallelForNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::ParallelFor);
+        out.string(varName);
+        out.node(start);
+        out.node(end);
+        out.node(step);
+        out.node(body);
+        out.u32(static_cast<uint32_t>(reductions.size()));
+        for (const ReductionVariable& reduction : reductions) {
+            out.u8(static_cast<uint8_t>(reduction.op));
+            out.string(reduction.name);
+        }
+    }
 };
 
 class ReturnException : public std::exception {
@@ -69,11 +128,15 @@ public:
 };
 
 class ReturnNode : public ASTNode {
-    Ref<ASTNode> expr;
+    ASTNode* expr;
 public:
-    ReturnNode(Ref<ASTNode> e) : expr(e) {}
-    Value evaluate(SymbolTable& scope) override { throw ReturnException(expr->evaluate(scope)); }
+    ReturnNode(ASTNode* e) : expr(e) {}
+    Value evaluate(SymbolTable& scope) override { throw ReturnException(expr ? expr->evaluate(scope) : Value()); }
     std::string toString() const override { return "ReturnNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Return);
+        out.node(expr);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
@@ -1,11 +1,98 @@
 #include "FunctionNodes.hpp"
 #include "BasicNodes.hpp"
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <stdexcept>
 #include "ControlFlowNodes.hpp"
 #include "../JeveInterpreter.hpp"
+#include "../Sorting.hpp"
 
 namespace jeve {
 
+namespace {
+
+UserFunctionNode* functionArgument(const Value& value, size_t params, const std::string& builtin) {
+    auto* function = value.getType() == Value::Type::Object ? dynamic_cast<UserFunctionNode*>(value.getObject()) : nullptr;
+    if (!function || function->getParams().size() != params) {
+        throw std::runtime_error(builtin + ": expected a function of " + std::to_string(params) +
+                                 (params == 1 ? " argument" : " arguments"));
+    }
+    return function;
+}
+
+// Elements of an array or range, readable by index from any thread
+class Elements {
+private:
+    Value source;
+    const std::vector<Value>* array = nullptr;
+
+public:
+    Elements(Value value, const std::string& builtin) : source(std::move(value)) {
+        if (source.getType() == Value::Type::Array) {
+            array = &static_cast<const Value&>(source).getArray();
+        } else if (source.getType() != Value::Type::Range) {
+            throw std::runtime_error(builtin + ": first arg must be an array or range");
+        }
+    }
+
+    size_t size() const { return array ? array->size() : source.getRange().size(); }
+    Value at(size_t i) const { return array ? (*array)[i] : Value(source.getRange().at(i)); }
+};
+
+// Calls a user function for map(), filter() and reduce(). Large inputs are
+// split across the interpreter's threads; each worker calls the function
+// from a frame of its own, marked parallel whatever the input size so that
+// a callback behaves the same on small and large arrays. Small inputs run
+// on one thread under the same rules, unless parallel calls are disabled.
+class ElementCalls {
+private:
+    UserFunctionNode* function;
+    SymbolTable& scope;
+    JeveInterpreter* interpreter;
+    bool parallel;
+    // Below the threshold; bounded, so what the calls create can wait for
+    // the end to join the heap
+    bool small;
+    std::vector<std::unique_ptr<SymbolTable>> frames;
+    std::vector<std::unique_ptr<FunctionInvoker>> invokers;
+
+public:
+    ElementCalls(UserFunctionNode* fn, SymbolTable& s, JeveInterpreter* interp, size_t count)
+        : function(fn), scope(s), interpreter(interp) {
+        size_t threshold = interpreter ? interpreter->getParallelMapThreshold() : 0;
+        parallel = threshold > 0 && count >= threshold;
+        small = threshold > 0 && count < threshold;
+        size_t workers = parallel ? interpreter->getThreadPool().size() : 1;
+        frames.resize(workers);
+        invokers.resize(workers);
+    }
+
+    size_t workers() const { return invokers.size(); }
+
+    FunctionInvoker& invoker(size_t worker) {
+        if (!invokers[worker]) {
+            frames[worker] = std::make_unique<SymbolTable>(&scope);
+            frames[worker]->setParallelFrame();
+            invokers[worker] = std::make_unique<FunctionInvoker>(function, *frames[worker]);
+        }
+        return *invokers[worker];
+    }
+
+    // Runs body(worker, begin, end) over [0, count)
+    void run(size_t count, const std::function<void(size_t, size_t, size_t)>& body) {
+        if (parallel) {
+            interpreter->runParallel(count, body);
+        } else if (small && count > 0) {
+            interpreter->runAsWorker(count, body);
+        } else if (count > 0) {
+            body(0, 0, count);
+        }
+    }
+};
+
+} // namespace
+
 Value FunctionCallNode::evaluate(SymbolTable& scope) {
     // Built-in functions
     if (name == "print") {
@@ -15,51 +102,39 @@ Value FunctionCallNode::evaluate(SymbolTable& scope) {
     }
     if (name == "insert") {
         if (arguments.size() != 3) throw std::runtime_error("insert() needs 3 args");
-        auto* idNode = dynamic_cast<IdentifierNode*>(arguments[0].get());
+        auto* idNode = dynamic_cast<IdentifierNode*>(arguments[0]);
         if (!idNode) throw std::runtime_error("insert: first arg must be array variable");
-        Value& arr = scope.getMutable(idNode->getName());
+        bool shared;
+        Value& arr = scope.getMutable(idNode->getName(), shared);
+        if (shared) throw std::runtime_error("insert: cannot resize '" + idNode->getName() + "' inside parallel code");
         int64_t idx = arguments[1]->evaluate(scope).getInteger();
         Value val = arguments[2]->evaluate(scope);
-        auto& elems = arr.getArray();
+        ValueArray* target = arr.prepareArrayForModification();
+        if (AllocationBuffer::isShared(target)) throw std::runtime_error("insert: cannot resize an array created outside parallel code");
+        auto lock = target->writeLock();
+        auto& elems = target->getElements();
         if (idx < 0 || static_cast<size_t>(idx) > elems.size()) throw std::runtime_error("insert: index out of bounds");
         
-        if (!interpreter) {
-            throw std::runtime_error("Interpreter not set for FunctionCallNode");
-        }
-        
-        // Create a new object based on the value type
-        Value newVal;
-        switch (val.getType()) {
-            case Value::Type::Integer:
-                newVal = Value(Ref<Object>(interpreter->createObject<NumberNode>(val.getInteger())));
-                break;
-            case Value::Type::Float:
-                newVal = Value(Ref<Object>(interpreter->createObject<NumberNode>(val.getFloat())));
-                break;
-            case Value::Type::String:
-                newVal = Value(Ref<Object>(interpreter->createObject<StringNode>(val.getString())));
-                break;
-            case Value::Type::Boolean:
-                newVal = Value(Ref<Object>(interpreter->createObject<BooleanNode>(val.getBoolean())));
-                break;
-            case Value::Type::Array:
-                newVal = val; // Arrays are already GC-managed
-                break;
-            default:
-                newVal = val;
-                break;
-        }
-        
-        elems.insert(elems.begin() + idx, newVal);
+        elems.insert(elems.begin() + idx, val);
         return Value();
     }
     if (name == "delete") {
         if (arguments.size() != 2) throw std::runtime_error("delete() needs 2 args");
-        auto* idNode = dynamic_cast<IdentifierNode*>(arguments[0].get());
+        auto* idNode = dynamic_cast<IdentifierNode*>(arguments[0]);
         if (!idNode) throw std::runtime_error("delete: first arg must be array variable");
-        Value& arr = scope.getMutable(idNode->getName());
+        bool shared;
+        Value& arr = scope.getMutable(idNode->getName(), shared);
+        if (shared) throw std::runtime_error("delete: cannot modify '" + idNode->getName() + "' inside parallel code");
+        if (arr.getType() == Value::Type::Map) {
+            Ref<ValueMap> map = arr.getMap();
+            if (AllocationBuffer::isShared(map.get())) throw std::runtime_error("delete: cannot modify a map created outside parallel code");
+            return Value(map->erase(arguments[1]->evaluate(scope)));
+        }
         int64_t idx = arguments[1]->evaluate(scope).getInteger();
-        auto& elems = arr.getArray();
+        ValueArray* target = arr.prepareArrayForModification();
+        if (AllocationBuffer::isShared(target)) throw std::runtime_error("delete: cannot resize an array created outside parallel code");
+        auto lock = target->writeLock();
+        auto& elems = target->getElements();
         if (idx < 0 || static_cast<size_t>(idx) >= elems.size()) throw std::runtime_error("delete: index out of bounds");
         elems.erase(elems.begin() + idx);
         return Value();
@@ -71,9 +146,168 @@ Value FunctionCallNode::evaluate(SymbolTable& scope) {
             return Value(static_cast<int64_t>(arg.getArray().size()));
         } else if (arg.getType() == Value::Type::String) {
             return Value(static_cast<int64_t>(arg.getString().size()));
+        } else if (arg.getType() == Value::Type::Map) {
+            return Value(static_cast<int64_t>(arg.getMap()->size()));
+        } else if (arg.getType() == Value::Type::Range) {
+            return Value(static_cast<int64_t>(arg.getRange().size()));
+        } else {
+            throw std::runtime_error("length() argument must be array, string, map or range");
+        }
+    }
+    if (name == "sort") {
+        // sort(arr) or sort(arr, cmpFn); sorts in place and returns the array
+        if (arguments.empty() || arguments.size() > 2) throw std::runtime_error("sort() takes 1 or 2 arguments");
+        Value arr = arguments[0]->evaluate(scope);
+        if (arr.getType() != Value::Type::Array) throw std::runtime_error("sort: first arg must be an array");
+        ValueArray* target = arr.prepareArrayForModification();
+        // Sorting rewrites every element, so other workers may not share the array
+        if (AllocationBuffer::isShared(target)) throw std::runtime_error("sort: cannot sort an array created outside parallel code");
+        if (arguments.size() == 1) {
+            auto lock = target->writeLock();
+            auto& elems = target->getElements();
+            ThreadPool* pool = nullptr;
+            size_t threshold = 0;
+            if (interpreter) {
+                threshold = interpreter->getParallelSortThreshold();
+                if (threshold > 0 && elems.size() >= threshold) pool = &interpreter->getThreadPool();
+            }
+            sortValues(elems, pool, threshold);
+            return arr;
+        }
+        Value cmp = arguments[1]->evaluate(scope);
+        auto* cmpFunc = cmp.getType() == Value::Type::Object ? dynamic_cast<UserFunctionNode*>(cmp.getObject()) : nullptr;
+        if (!cmpFunc || cmpFunc->getParams().size() != 2) {
+            throw std::runtime_error("sort: comparator must be a function of 2 arguments");
+        }
+        FunctionInvoker invoke(cmpFunc, scope);
+        // The comparator may insert into or delete from this very array, so
+        // it sorts a copy, which is written back once it is done
+        std::vector<Value> sorted;
+        {
+            auto lock = target->writeLock();
+            sorted = target->getElements();
+        }
+        sortValues(sorted, [&](const Value& a, const Value& b) {
+            Value args[2] = {a, b};
+            Value result = invoke(args, 2);
+            // A comparator may answer "a before b" or return a negative number
+            if (result.getType() == Value::Type::Integer) return result.getInteger() < 0;
+            if (result.getType() == Value::Type::Float) return result.getFloat() < 0.0;
+            return result.toBoolean();
+        });
+        auto lock = target->writeLock();
+        target->getElements() = std::move(sorted);
+        return arr;
+    }
+    if (name == "map" && arguments.size() == 2) {
+        // map(arr, fn): a new array of fn(x) for every element, in order
+        Elements elements(arguments[0]->evaluate(scope), "map");
+        ElementCalls calls(functionArgument(arguments[1]->evaluate(scope), 1, "map"), scope, interpreter, elements.size());
+        std::vector<Value> results(elements.size());
+        calls.run(results.size(), [&](size_t worker, size_t begin, size_t end) {
+            FunctionInvoker& invoke = calls.invoker(worker);
+            for (size_t i = begin; i < end; ++i) {
+                Value arg = elements.at(i);
+                results[i] = invoke(&arg, 1);
+            }
+        });
+        return Value(results, interpreter ? interpreter->getGC().getObjectPool() : nullptr);
+    }
+    if (name == "filter") {
+        // filter(arr, fn): the elements for which fn(x) is true, in order
+        if (arguments.size() != 2) throw std::runtime_error("filter() takes 2 arguments");
+        Elements elements(arguments[0]->evaluate(scope), "filter");
+        ElementCalls calls(functionArgument(arguments[1]->evaluate(scope), 1, "filter"), scope, interpreter, elements.size());
+        std::vector<char> keep(elements.size());
+        calls.run(keep.size(), [&](size_t worker, size_t begin, size_t end) {
+            FunctionInvoker& invoke = calls.invoker(worker);
+            for (size_t i = begin; i < end; ++i) {
+                Value arg = elements.at(i);
+                keep[i] = invoke(&arg, 1).toBoolean();
+            }
+        });
+        std::vector<Value> results;
+        for (size_t i = 0; i < keep.size(); ++i) {
+            if (keep[i]) results.push_back(elements.at(i));
+        }
+        return Value(results, interpreter ? interpreter->getGC().getObjectPool() : nullptr);
+    }
+    if (name == "reduce") {
+        // reduce(arr, fn, init): fn(...fn(fn(init, x0), x1)..., xn). Split
+        // across threads, each block is folded from its first element and
+        // the block results are folded onto init in order, which gives the
+        // same answer when fn is associative.
+        if (arguments.size() != 3) throw std::runtime_error("reduce() takes 3 arguments");
+        Elements elements(arguments[0]->evaluate(scope), "reduce");
+        ElementCalls calls(functionArgument(arguments[1]->evaluate(scope), 2, "reduce"), scope, interpreter, elements.size());
+        Value init = arguments[2]->evaluate(scope);
+        size_t count = elements.size();
+        size_t blocks = calls.workers() == 1 ? 0 : std::min(count, calls.workers() * 8);
+        std::vector<Value> partials(blocks);
+        calls.run(blocks, [&](size_t worker, size_t first, size_t last) {
+            FunctionInvoker& invoke = calls.invoker(worker);
+            for (size_t block = first; block < last; ++block) {
+                size_t begin = count * block / blocks, end = count * (block + 1) / blocks;
+                Value args[2] = {elements.at(begin), Value()};
+                for (size_t i = begin + 1; i < end; ++i) {
+                    args[1] = elements.at(i);
+                    args[0] = invoke(args, 2);
+                }
+                partials[block] = std::move(args[0]);
+            }
+        });
+        FunctionInvoker& invoke = calls.invoker(0);
+        Value args[2] = {std::move(init), Value()};
+        if (blocks == 0) {
+            for (size_t i = 0; i < count; ++i) {
+                args[1] = elements.at(i);
+                args[0] = invoke(args, 2);
+            }
         } else {
-            throw std::runtime_error("length() argument must be array or string");
+            for (Value& partial : partials) {
+                args[1] = std::move(partial);
+                args[0] = invoke(args, 2);
+            }
+        }
+        return args[0];
+    }
+    if (name == "map") {
+        if (!arguments.empty()) throw std::runtime_error("map() takes no arguments or an array and a function");
+        if (!interpreter) {
+            throw std::runtime_error("Interpreter not set for FunctionCallNode");
         }
+        return Value(interpreter->createObject<ValueMap>());
+    }
+    if (name == "has") {
+        if (arguments.size() != 2) throw std::runtime_error("has() takes 2 arguments");
+        Value container = arguments[0]->evaluate(scope);
+        if (container.getType() != Value::Type::Map) throw std::runtime_error("has: first arg must be a map");
+        return Value(container.getMap()->find(arguments[1]->evaluate(scope)) != nullptr);
+    }
+    if (name == "keys") {
+        if (arguments.size() != 1) throw std::runtime_error("keys() takes 1 argument");
+        Value container = arguments[0]->evaluate(scope);
+        if (container.getType() != Value::Type::Map) throw std::runtime_error("keys: argument must be a map");
+        auto map = container.getMap();
+        std::vector<Value> result;
+        result.reserve(map->size());
+        for (size_t slot = 0; slot < map->capacity(); ++slot) {
+            if (map->occupied(slot)) result.push_back(map->keyAt(slot));
+        }
+        return Value(result, map->getPool());
+    }
+    if (name == "range") {
+        // range(end), range(start, end) or range(start, end, step); end is exclusive
+        if (arguments.empty() || arguments.size() > 3) throw std::runtime_error("range() takes 1 to 3 arguments");
+        int64_t bounds[3] = {0, 0, 1};
+        size_t first = arguments.size() == 1 ? 1 : 0;
+        for (size_t i = 0; i < arguments.size(); ++i) {
+            Value arg = arguments[i]->evaluate(scope);
+            if (arg.getType() != Value::Type::Integer) throw std::runtime_error("range() arguments must be integers");
+            bounds[first + i] = arg.getInteger();
+        }
+        if (bounds[2] == 0) throw std::runtime_error("range() step cannot be zero");
+        return Value(RangeValue{bounds[0], bounds[1], bounds[2]});
     }
 
     // User-defined functions
@@ -88,15 +322,11 @@ Value FunctionCallNode::evaluate(SymbolTable& scope) {
                 SymbolTable localScope(&scope);
                 for (size_t i = 0; i < params.size(); ++i)
                     localScope.set(params[i], arguments[i]->evaluate(scope));
-                try {
-                    return userFunc->getBody()->evaluate(localScope);
-                } catch (const ReturnException& e) {
-                    return e.getValue();
-                }
+                return userFunc->invoke(localScope);
             }
         }
     }
-    if (g_jeve_debug) std::cerr << "[DEBUG] Unknown function called: '" << name << "'" << std::endl;
+    if (interpreter && interpreter->isDebug()) std::cerr << "[DEBUG] Unknown function called: '" << name << "'" << std::endl;
     throw std::runtime_error("Unknown function: '" + name + "'");
 }
 
@@ -105,4 +335,58 @@ Value UserFunctionNode::evaluate(SymbolTable&) {
     return Value();
 }
 
+ASTNode* UserFunctionNode::getBody() const {
+    if (!isParsed()) {
+        std::call_once(bodyParsed, [this] {
+            body = interpreter->parseFunctionBody(*program, bodyStart);
+            parsed.store(true, std::memory_order_release);
+        });
+    }
+    return body;
+}
+
+void UserFunctionNode::setBody(ASTNode* compiled) {
+    std::call_once(bodyParsed, [this, compiled] {
+        body = compiled;
+        parsed.store(true, std::memory_order_release);
+    });
+}
+
+Value UserFunctionNode::invoke(SymbolTable& frame) {
+    Safepoint::poll();
+    try {
+        return getBody()->evaluate(frame);
+    } catch (const ReturnException& e) {
+        return e.getValue();
+    }
+}
+
+FunctionInvoker::FunctionInvoker(UserFunctionNode* fn, SymbolTable& scope)
+    : function(fn), parent(&scope) {
+    resetFrame();
+}
+
+void FunctionInvoker::resetFrame() {
+    frame = std::make_unique<SymbolTable>(parent);
+    slots.clear();
+    for (const auto& param : function->getParams()) {
+        slots.push_back(&frame->slot(param));
+    }
+}
+
+Value FunctionInvoker::operator()(const Value* args, size_t count) {
+    if (count != slots.size()) {
+        throw std::runtime_error("Function '" + function->getName() + "' expects " + std::to_string(slots.size()) + " arguments");
+    }
+    for (size_t i = 0; i < count; ++i) {
+        *slots[i] = args[i];
+    }
+    Value result = function->invoke(*frame);
+    // Locals created by the body must not leak into the next call
+    if (frame->size() != slots.size()) {
+        resetFrame();
+    }
+    return result;
+}
+
 } // namespace jeve 
\ No newline at end of file
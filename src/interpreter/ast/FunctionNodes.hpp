@@ -2,41 +2,90 @@
 
 #include "../ASTNode.hpp"
 #include "../Forward.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 
 namespace jeve {
 
 class JeveInterpreter;
+class Program;
 
 class FunctionCallNode : public ASTNode {
 private:
     std::string name;
-    std::vector<Ref<ASTNode>> arguments;
+    std::vector<ASTNode*> arguments;
     JeveInterpreter* interpreter;
 
 public:
-    FunctionCallNode(const std::string& n, const std::vector<Ref<ASTNode>>& args, JeveInterpreter* interp = nullptr)
-        : name(n), arguments(args), interpreter(interp) {}
+    FunctionCallNode(std::string n, std::vector<ASTNode*> args, JeveInterpreter* interp = nullptr)
+        : name(std::move(n)), arguments(std::move(args)), interpreter(interp) {}
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "FunctionCallNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::FunctionCall);
+        out.string(name);
+        out.nodes(arguments);
+    }
 };
 
 class UserFunctionNode : public ASTNode {
 private:
     std::string name;
     std::vector<std::string> params;
-    Ref<ASTNode> body;
+    mutable ASTNode* body;
     JeveInterpreter* interpreter;
+    // Where an unparsed body starts in its program's source (or body decoder)
+    Program* program = nullptr;
+    size_t bodyStart = 0;
+    mutable std::once_flag bodyParsed;
+    mutable std::atomic<bool> parsed{false};
 
 public:
-    UserFunctionNode(const std::string& n, const std::vector<std::string>& p, Ref<ASTNode> b, JeveInterpreter* interp = nullptr)
+    UserFunctionNode(const std::string& n, const std::vector<std::string>& p, ASTNode* b, JeveInterpreter* interp = nullptr)
         : name(n), params(p), body(b), interpreter(interp) {}
+    // A function whose body is parsed from the '{' at start on first use
+    UserFunctionNode(const std::string& n, const std::vector<std::string>& p, Program* prog, size_t start, JeveInterpreter* interp)
+        : name(n), params(p), body(nullptr), interpreter(interp), program(prog), bodyStart(start) {}
     const std::string& getName() const { return name; }
     const std::vector<std::string>& getParams() const { return params; }
-    Ref<ASTNode> getBody() const { return body; }
+    // Parses a lazy body the first time it is needed; may throw ParseError
+    ASTNode* getBody() const;
+    bool isParsed() const { return !program || parsed.load(std::memory_order_acquire); }
+    size_t getBodyStart() const { return bodyStart; }
+    // Installs a body compiled elsewhere; ignored if one was parsed meanwhile
+    void setBody(ASTNode* compiled);
+    // Runs the body in a frame whose parameters are already bound
+    Value invoke(SymbolTable& frame);
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "UserFunctionNode(" + name + ")"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::UserFunction);
+        out.string(name);
+        out.stringList(params);
+        out.node(getBody());
+    }
+};
+
+// Calls a user function repeatedly from native code, e.g. a sort comparator.
+// Parameter slots are resolved once and the call frame is reused for as long
+// as the body does not declare locals of its own.
+class FunctionInvoker {
+private:
+    UserFunctionNode* function;
+    SymbolTable* parent;
+    std::unique_ptr<SymbolTable> frame;
+    std::vector<Value*> slots;
+
+    void resetFrame();
+
+public:
+    FunctionInvoker(UserFunctionNode* fn, SymbolTable& scope);
+
+    Value operator()(const Value* args, size_t count);
 };
 
 } // namespace jeve 
\ No newline at end of file
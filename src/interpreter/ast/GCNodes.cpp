@@ -1,15 +1,14 @@
 #include "GCNodes.hpp"
 #include <iostream>
 
-extern bool g_jeve_debug;
-
 namespace jeve {
 
 Value DebugGCNode::evaluate(SymbolTable& scope) {
-    if (gc && g_jeve_debug) {
-        std::cout << "GC Stats (GC: " << gc << ", Pool: " << gc->getObjectPool() << "):" << std::endl;
-        std::cout << "  Objects: " << gc->getObjectCount() << std::endl;
-        std::cout << "  Heap usage: " << gc->getHeapUsage() << " bytes" << std::endl;
+    if (gc && gc->isDebug()) {
+        std::ostream& log = gc->getLog();
+        log << "GC Stats (GC: " << gc << ", Pool: " << gc->getObjectPool() << "):" << std::endl;
+        log << "  Objects: " << gc->getObjectCount() << std::endl;
+        log << "  Heap usage: " << gc->getHeapUsage() << " bytes" << std::endl;
         gc->printStats();
     }
     return Value();
@@ -17,7 +16,7 @@ Value DebugGCNode::evaluate(SymbolTable& scope) {
 
 Value CleanGCNode::evaluate(SymbolTable& scope) {
     if (gc) {
-        gc->collect();
+        gc->requestCollection();
     }
     return Value();
 }
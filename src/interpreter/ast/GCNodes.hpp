@@ -14,6 +14,9 @@ public:
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "DebugGCNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::DebugGC);
+    }
 };
 
 class CleanGCNode : public ASTNode {
@@ -25,6 +28,9 @@ public:
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "CleanGCNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::CleanGC);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
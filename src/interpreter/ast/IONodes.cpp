@@ -1,4 +1,5 @@
 #include "IONodes.hpp"
+#include "../JeveInterpreter.hpp"
 #include <iostream>
 #include <stdexcept>
 
@@ -6,14 +7,25 @@ namespace jeve {
 
 Value PrintNode::evaluate(SymbolTable& scope) {
     Value result = expression->evaluate(scope);
-    std::cout << result.toString() << std::endl;
+    if (!interpreter) {
+        std::cout << result.toString() << std::endl;
+        return result;
+    }
+    std::string text = result.toString();
+    std::lock_guard<std::mutex> lock(interpreter->getIOMutex());
+    interpreter->getOutput() << text << std::endl;
     return result;
 }
 
 Value InputNode::evaluate(SymbolTable& scope) {
     (void)scope;
     std::string input;
-    std::getline(std::cin, input);
+    if (interpreter) {
+        std::lock_guard<std::mutex> lock(interpreter->getIOMutex());
+        std::getline(interpreter->getInput(), input);
+    } else {
+        std::getline(std::cin, input);
+    }
     
     if (type.empty()) {
         // Try to infer type
@@ -7,26 +7,36 @@ namespace jeve {
 
 class PrintNode : public ASTNode {
 private:
-    Ref<ASTNode> expression;
+    ASTNode* expression;
+    JeveInterpreter* interpreter;  // whose output stream to use
 
 public:
-    PrintNode(Ref<ASTNode> expr) : expression(expr) {}
+    PrintNode(ASTNode* expr, JeveInterpreter* interp = nullptr) : expression(expr), interpreter(interp) {}
 
-    ASTNode* getExpression() const { return expression.get(); }
+    ASTNode* getExpression() const { return expression; }
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "PrintNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Print);
+        out.node(expression);
+    }
 };
 
 class InputNode : public ASTNode {
 private:
     std::string type;  // Optional type annotation
+    JeveInterpreter* interpreter;
 
 public:
-    InputNode(const std::string& t = "") : type(t) {}
+    InputNode(const std::string& t = "", JeveInterpreter* interp = nullptr) : type(t), interpreter(interp) {}
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "InputNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::Input);
+        out.string(type);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
@@ -3,74 +3,97 @@
 
 namespace jeve {
 
+namespace {
+
+template<typename T>
+bool compare(BinaryOperator op, const T& l, const T& r, Value& result) {
+    switch (op) {
+        case BinaryOperator::Equal: result = Value(l == r); return true;
+        case BinaryOperator::NotEqual: result = Value(l != r); return true;
+        case BinaryOperator::Less: result = Value(l < r); return true;
+        case BinaryOperator::Greater: result = Value(l > r); return true;
+        case BinaryOperator::LessEqual: result = Value(l <= r); return true;
+        case BinaryOperator::GreaterEqual: result = Value(l >= r); return true;
+        default: return false;
+    }
+}
+
+} // namespace
+
 Value BinaryOpNode::evaluate(SymbolTable& scope) {
     Value lval = left->evaluate(scope);
     Value rval = right->evaluate(scope);
+    return applyBinaryOperator(op, lval, rval);
+}
+
+Value applyBinaryOperator(BinaryOperator op, const Value& lval, const Value& rval) {
+    Value result;
     
     if (lval.getType() == Value::Type::Integer && rval.getType() == Value::Type::Integer) {
         int64_t l = lval.getInteger();
         int64_t r = rval.getInteger();
         
-        if (op == "+") return Value(l + r);
-        if (op == "-") return Value(l - r);
-        if (op == "*") return Value(l * r);
-        if (op == "/") {
-            if (r == 0) throw std::runtime_error("Division by zero");
-            return Value(l / r);
+        switch (op) {
+            case BinaryOperator::Add: return Value(l + r);
+            case BinaryOperator::Subtract: return Value(l - r);
+            case BinaryOperator::Multiply: return Value(l * r);
+            case BinaryOperator::Divide:
+                if (r == 0) throw std::runtime_error("Division by zero");
+                return Value(l / r);
+            case BinaryOperator::Modulo:
+                if (r == 0) throw std::runtime_error("Modulo by zero");
+                return Value(l % r);
+            case BinaryOperator::And: return Value(l != 0 && r != 0);  // Logical AND
+            case BinaryOperator::Or: return Value(l != 0 || r != 0);   // Logical OR
+            default:
+                if (compare(op, l, r, result)) return result;
+                break;
         }
-        if (op == "%") {
-            if (r == 0) throw std::runtime_error("Modulo by zero");
-            return Value(l % r);
+    } else if (lval.getType() == Value::Type::String || rval.getType() == Value::Type::String) {
+        // Checked before floats so that "x" + 1.5 concatenates
+        std::string lstr = lval.toString();
+        std::string rstr = rval.toString();
+        
+        switch (op) {
+            case BinaryOperator::Add: return Value(lstr + rstr);
+            case BinaryOperator::Equal: return Value(lstr == rstr);
+            case BinaryOperator::NotEqual: return Value(lstr != rstr);
+            case BinaryOperator::And: return Value(!lstr.empty() && !rstr.empty());  // Logical AND
+            case BinaryOperator::Or: return Value(!lstr.empty() || !rstr.empty());   // Logical OR
+            default: break;
         }
-        if (op == "==") return Value(l == r);
-        if (op == "!=") return Value(l != r);
-        if (op == "<") return Value(l < r);
-        if (op == ">") return Value(l > r);
-        if (op == "<=") return Value(l <= r);
-        if (op == ">=") return Value(l >= r);
-        if (op == "&") return Value(l != 0 && r != 0);  // Logical AND
-        if (op == "|") return Value(l != 0 || r != 0);  // Logical OR
     } else if (lval.getType() == Value::Type::Float || rval.getType() == Value::Type::Float) {
         double l = (lval.getType() == Value::Type::Float) ? lval.getFloat() : static_cast<double>(lval.getInteger());
         double r = (rval.getType() == Value::Type::Float) ? rval.getFloat() : static_cast<double>(rval.getInteger());
         
-        if (op == "+") return Value(l + r);
-        if (op == "-") return Value(l - r);
-        if (op == "*") return Value(l * r);
-        if (op == "/") {
-            if (r == 0.0) throw std::runtime_error("Division by zero");
-            return Value(l / r);
+        switch (op) {
+            case BinaryOperator::Add: return Value(l + r);
+            case BinaryOperator::Subtract: return Value(l - r);
+            case BinaryOperator::Multiply: return Value(l * r);
+            case BinaryOperator::Divide:
+                if (r == 0.0) throw std::runtime_error("Division by zero");
+                return Value(l / r);
+            case BinaryOperator::Modulo:
+                if (r == 0.0) throw std::runtime_error("Modulo by zero");
+                return Value(std::fmod(l, r));
+            case BinaryOperator::And: return Value(l != 0.0 && r != 0.0);  // Logical AND
+            case BinaryOperator::Or: return Value(l != 0.0 || r != 0.0);   // Logical OR
+            default:
+                if (compare(op, l, r, result)) return result;
+                break;
         }
-        if (op == "%") {
-            if (r == 0.0) throw std::runtime_error("Modulo by zero");
-            return Value(std::fmod(l, r));
-        }
-        if (op == "==") return Value(l == r);
-        if (op == "!=") return Value(l != r);
-        if (op == "<") return Value(l < r);
-        if (op == ">") return Value(l > r);
-        if (op == "<=") return Value(l <= r);
-        if (op == ">=") return Value(l >= r);
-        if (op == "&") return Value(l != 0.0 && r != 0.0);  // Logical AND
-        if (op == "|") return Value(l != 0.0 || r != 0.0);  // Logical OR
-    } else if (lval.getType() == Value::Type::String || rval.getType() == Value::Type::String) {
-        std::string lstr = lval.toString();
-        std::string rstr = rval.toString();
-        
-        if (op == "+") return Value(lstr + rstr);
-        if (op == "==") return Value(lstr == rstr);
-        if (op == "!=") return Value(lstr != rstr);
-        if (op == "&") return Value(!lstr.empty() && !rstr.empty());  // Logical AND
-        if (op == "|") return Value(!lstr.empty() || !rstr.empty());  // Logical OR
     } else if (lval.getType() == Value::Type::Boolean && rval.getType() == Value::Type::Boolean) {
         bool l = lval.getBoolean();
         bool r = rval.getBoolean();
         
-        if (op == "==") return Value(l == r);
-        if (op == "!=") return Value(l != r);
-        if (op == "&") return Value(l && r);
-        if (op == "|") return Value(l || r);
-    } else if (lval.getType() == Value::Type::Array && rval.getType() == Value::Type::Array && op == "+") {
+        switch (op) {
+            case BinaryOperator::Equal: return Value(l == r);
+            case BinaryOperator::NotEqual: return Value(l != r);
+            case BinaryOperator::And: return Value(l && r);
+            case BinaryOperator::Or: return Value(l || r);
+            default: break;
+        }
+    } else if (lval.getType() == Value::Type::Array && rval.getType() == Value::Type::Array && op == BinaryOperator::Add) {
         const auto& leftArray = lval.getArray();
         const auto& rightArray = rval.getArray();
         
@@ -80,15 +103,14 @@ Value BinaryOpNode::evaluate(SymbolTable& scope) {
         result.insert(result.end(), leftArray.begin(), leftArray.end());
         result.insert(result.end(), rightArray.begin(), rightArray.end());
         
-        return Value(result);
+        return Value(result, lval.getArrayObject()->getPool());
     }
     
     // Handle mixed type logical operations
-    if (op == "&" || op == "|") {
+    if (op == BinaryOperator::And || op == BinaryOperator::Or) {
         bool l = lval.toBoolean();
         bool r = rval.toBoolean();
-        if (op == "&") return Value(l && r);
-        if (op == "|") return Value(l || r);
+        return Value(op == BinaryOperator::And ? (l && r) : (l || r));
     }
     
     throw std::runtime_error("Invalid operation between types");
@@ -96,16 +118,16 @@ Value BinaryOpNode::evaluate(SymbolTable& scope) {
 
 Value UnaryOpNode::evaluate(SymbolTable& scope) {
     Value val = operand->evaluate(scope);
-    if (op == "-") {
+    if (op == UnaryOperator::Negate) {
         if (val.getType() == Value::Type::Integer) {
             return Value(-val.getInteger());
         } else if (val.getType() == Value::Type::Float) {
             return Value(-val.getFloat());
         }
-    } else if (op == "!") {
+    } else if (op == UnaryOperator::Not) {
         return Value(!val.toBoolean());
     }
     throw std::runtime_error("Invalid unary operation");
 }
 
-} // namespace jeve 
\ No newline at end of file
+} // namespace jeve
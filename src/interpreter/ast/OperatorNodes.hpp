@@ -5,34 +5,72 @@
 
 namespace jeve {
 
+enum class BinaryOperator {
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Equal,
+    NotEqual,
+    Less,
+    Greater,
+    LessEqual,
+    GreaterEqual,
+    And,
+    Or
+};
+
+enum class UnaryOperator {
+    Negate,
+    Not
+};
+
+// Applies a binary operator to operands that are already evaluated
+Value applyBinaryOperator(BinaryOperator op, const Value& lval, const Value& rval);
+
 class BinaryOpNode : public ASTNode {
 private:
-    Ref<ASTNode> left;
-    Ref<ASTNode> right;
-    std::string op;
+    ASTNode* left;
+    ASTNode* right;
+    BinaryOperator op;
 
 public:
-    BinaryOpNode(Ref<ASTNode> l, Ref<ASTNode> r, const std::string& o)
+    BinaryOpNode(ASTNode* l, ASTNode* r, BinaryOperator o)
         : left(l), right(r), op(o) {}
     
-    ASTNode* getLeft() const { return left.get(); }
-    ASTNode* getRight() const { return right.get(); }
+    ASTNode* getLeft() const { return left; }
+    ASTNode* getRight() const { return right; }
+    BinaryOperator getOperator() const { return op; }
     
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "BinaryOpNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::BinaryOp);
+        out.u8(static_cast<uint8_t>(op));
+        out.node(left);
+        out.node(right);
+    }
 };
 
 class UnaryOpNode : public ASTNode {
 private:
-    Ref<ASTNode> operand;
-    std::string op;
+    ASTNode* operand;
+    UnaryOperator op;
 
 public:
-    UnaryOpNode(Ref<ASTNode> op, const std::string& o)
-        : operand(op), op(o) {}
+    UnaryOpNode(ASTNode* operand, UnaryOperator o)
+        : operand(operand), op(o) {}
+
+    UnaryOperator getOperator() const { return op; }
 
     Value evaluate(SymbolTable& scope) override;
     std::string toString() const override { return "UnaryOpNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::UnaryOp);
+        out.u8(static_cast<uint8_t>(op));
+        out.node(operand);
+    }
 };
 
-} // namespace jeve 
\ No newline at end of file
+} // namespace jeve
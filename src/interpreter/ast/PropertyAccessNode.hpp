@@ -7,11 +7,11 @@ namespace jeve {
 
 class PropertyAccessNode : public ASTNode {
 private:
-    Ref<ASTNode> object;
+    ASTNode* object;
     std::string property;
 
 public:
-    PropertyAccessNode(Ref<ASTNode> obj, const std::string& prop)
+    PropertyAccessNode(ASTNode* obj, const std::string& prop)
         : object(obj), property(prop) {}
 
     Value evaluate(SymbolTable& scope) override {
@@ -22,6 +22,10 @@ public:
                 return Value(static_cast<int64_t>(objValue.getArray().size()));
             } else if (objValue.getType() == Value::Type::String) {
                 return Value(static_cast<int64_t>(objValue.getString().length()));
+            } else if (objValue.getType() == Value::Type::Map) {
+                return Value(static_cast<int64_t>(objValue.getMap()->size()));
+            } else if (objValue.getType() == Value::Type::Range) {
+                return Value(static_cast<int64_t>(objValue.getRange().size()));
             }
         }
         
@@ -29,6 +33,11 @@ public:
     }
 
     std::string toString() const override { return "PropertyAccessNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::PropertyAccess);
+        out.string(property);
+        out.node(object);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
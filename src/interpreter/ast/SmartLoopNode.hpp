@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../ASTNode.hpp"
+#include "../ValueIterator.hpp"
+#include "BasicNodes.hpp"
 #include <string>
 
 namespace jeve {
@@ -9,34 +11,46 @@ class SmartLoopNode : public ASTNode {
 private:
     std::string valueName;
     std::string indexName;
-    Ref<ASTNode> array;
-    Ref<BlockNode> body;
+    ASTNode* array;
+    BlockNode* body;
 
 public:
     SmartLoopNode(const std::string& valName, const std::string& idxName,
-                 Ref<ASTNode> arr, Ref<BlockNode> b)
+                 ASTNode* arr, BlockNode* b)
         : valueName(valName), indexName(idxName), array(arr), body(b) {}
 
     Value evaluate(SymbolTable& scope) override {
-        Value arrayValue = array->evaluate(scope);
-        
-        if (arrayValue.getType() != Value::Type::Array) {
-            throw std::runtime_error("Cannot iterate over non-array value");
+        // Iterate a variable in place instead of copying its value out of the scope
+        Value temporary;
+        const Value* iterable;
+        if (auto* idNode = dynamic_cast<IdentifierNode*>(array)) {
+            iterable = &scope.get(idNode->getName());
+        } else {
+            temporary = array->evaluate(scope);
+            iterable = &temporary;
         }
         
-        const auto& elements = arrayValue.getArray();
+        ValueIterator it(*iterable);
+        Value& indexSlot = scope.slot(indexName);
+        Value& valueSlot = scope.slot(valueName);
         Value result;
         
-        for (size_t i = 0; i < elements.size(); ++i) {
-            scope.set(indexName, Value(static_cast<int64_t>(i)));
-            scope.set(valueName, elements[i]);
+        while (it.next(indexSlot, valueSlot)) {
             result = body->evaluate(scope);
+            Safepoint::poll();
         }
         
         return result;
     }
 
     std::string toString() const override { return "SmartLoopNode"; }
+    void serialize(ProgramWriter& out) const override {
+        out.tag(NodeTag::SmartLoop);
+        out.string(valueName);
+        out.string(indexName);
+        out.node(array);
+        out.node(body);
+    }
 };
 
 } // namespace jeve 
\ No newline at end of file
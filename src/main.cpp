@@ -1,23 +1,45 @@
 #include "interpreter/JeveInterpreter.hpp"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
 #include "interpreter/GarbageCollector.hpp"
-
-// Global debug flag
-bool g_jeve_debug = false;
-
-namespace jeve {
-}
+#include "interpreter/HeapSnapshot.hpp"
+#include "interpreter/ProgramCache.hpp"
+#include "interpreter/ThreadPool.hpp"
+#include "Server.hpp"
 
 void printUsage(const std::string& programName) {
-    std::cout << "Usage: " << programName << " [options] <file>" << std::endl;
+    std::cout << "Usage: " << programName << " [options] <file>..." << std::endl;
     std::cout << "Options:" << std::endl;
-    std::cout << "  -Xms<size>  Set initial heap size (e.g., -Xms1m for 1MB)" << std::endl;
-    std::cout << "  -Xmx<size>  Set maximum heap size (e.g., -Xmx64m for 64MB)" << std::endl;
+    std::cout << "  -Xms<size>  Set initial heap size, committed up front (e.g., -Xms1m for 1MB)" << std::endl;
+    std::cout << "  -Xmx<size>  Set maximum heap size, reserved up front (e.g., -Xmx64m for 64MB)" << std::endl;
+    std::cout << "  --huge-pages  Back the heap with transparent huge pages where available" << std::endl;
     std::cout << "  --debug     Enable debug/GC logging" << std::endl;
+    std::cout << "  --gc=<mode>  generational (default), incremental: run major collections in short slices between allocations," << std::endl;
+    std::cout << "               or concurrent: mark on a background thread and sweep in slices" << std::endl;
+    std::cout << "  --gc-slice-us=<n>  Longest slice of an incremental or concurrent collection in microseconds (default 500)" << std::endl;
+    std::cout << "  --gc-threads=<n>  Threads that mark a large collection (default: one per core)" << std::endl;
+    std::cout << "  --gc-stats  Report the number, total, longest and 99th percentile of GC pauses and per-size-class slab usage when the script ends" << std::endl;
+    std::cout << "  --memory-log[=<file>]  Log heap usage after every allocation as CSV (default memory_usage.csv)" << std::endl;
+    std::cout << "  --threads=<n>  Threads for parallel for loops, sorting and compiling (default: one per core)" << std::endl;
+    std::cout << "  --parallel-sort-threshold=<n>  Sort arrays of at least n elements on all cores (0 disables)" << std::endl;
+    std::cout << "  --parallel-map-threshold=<n>  Run map/filter/reduce over at least n elements on all cores (0 disables)" << std::endl;
+    std::cout << "  --parallel-compile-threshold=<n>  Parse function bodies on all cores for programs with at least n functions (0 disables)" << std::endl;
+    std::cout << "  --eager     Parse every function body before running instead of on first call" << std::endl;
+    std::cout << "  --parse-only  Parse the file without running it and report parser throughput" << std::endl;
+    std::cout << "  --cache     Reuse a compiled copy of the script stored next to it (<file>c)" << std::endl;
+    std::cout << "  --cache-dir=<dir>  Like --cache, but keep compiled scripts in an existing directory" << std::endl;
+    std::cout << "  --snapshot-out=<file>  After the script runs, save its global variables and functions to file" << std::endl;
+    std::cout << "  --snapshot-in=<file>  Restore the globals saved by --snapshot-out before running the script" << std::endl;
+    std::cout << "  --jobs=<n>  Run several scripts (jeve --jobs=4 a.jeve b.jeve ...), n at a time, each in its own interpreter" << std::endl;
+    std::cout << "  --serve[=<socket>]  Run scripts sent by --client on pre-warmed workers (--jobs sets how many)" << std::endl;
+    std::cout << "  --client    Run the scripts on a --serve server instead of in this process" << std::endl;
+    std::cout << "  --socket=<path>  Socket for --serve and --client (default $JEVE_SOCKET, $XDG_RUNTIME_DIR/jeve.sock or /tmp/jeve-<uid>/jeve.sock)" << std::endl;
     std::cout << "  -h, --help  Show this help message" << std::endl;
 }
 
@@ -49,18 +71,176 @@ size_t parseMemorySize(const std::string& sizeStr) {
     return value * multiplier;
 }
 
+// Settings that apply to each script run from the command line
+struct RunSettings {
+    bool parseOnly = false;
+    bool useCache = false;
+    std::string cacheDir;
+    std::string snapshotIn;
+    std::string snapshotOut;
+};
+
+// Creates the interpreter a script runs in, with any snapshot already loaded
+std::unique_ptr<jeve::JeveInterpreter> prepareInterpreter(const jeve::InterpreterOptions& options,
+                                                          const RunSettings& settings) {
+    auto interpreter = std::make_unique<jeve::JeveInterpreter>(options);
+    if (!settings.snapshotIn.empty()) {
+        jeve::HeapSnapshot::load(*interpreter, settings.snapshotIn);
+    }
+    return interpreter;
+}
+
+// Runs a script in a prepared interpreter and returns the process exit code.
+// All messages go to the interpreter's output streams.
+int runCode(jeve::JeveInterpreter& interpreter, const std::string& filename, std::string code,
+            const RunSettings& settings) {
+    std::ostream& out = interpreter.getOutput();
+    std::ostream& err = interpreter.getErrorOutput();
+    try {
+        if (settings.parseOnly) {
+            size_t bytes = code.size();
+            auto start = std::chrono::steady_clock::now();
+            try {
+                auto program = interpreter.parse(std::move(code));
+                // Function bodies are normally parsed on first call; check them all here
+                interpreter.compileFunctions(*program);
+            } catch (const jeve::ParseError& e) {
+                err << e.getFormattedMessage() << std::endl;
+                return 1;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            out << "Parsed " << bytes << " bytes in " << seconds * 1000.0 << " ms ("
+                << (seconds > 0.0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0) << " MB/s)" << std::endl;
+            return 0;
+        }
+        std::string cachePath = settings.useCache ? jeve::ProgramCache::pathFor(filename, settings.cacheDir) : std::string();
+        interpreter.interpret(std::move(code), cachePath);
+        if (!settings.snapshotOut.empty()) {
+            jeve::HeapSnapshot::save(interpreter, settings.snapshotOut);
+        }
+        if (interpreter.isDebug()) out << "[Jeve] Interpreter finished" << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        if (interpreter.isDebug()) err << "[Jeve] Exception: " << e.what() << std::endl;
+        err << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// Runs one script in a fresh interpreter and returns the process exit code
+int runFile(const std::string& filename, const jeve::InterpreterOptions& options, const RunSettings& settings) {
+    std::ostream& out = *options.output;
+    std::ostream& err = *options.errorOutput;
+    if (options.debug) out << "[Jeve] Loading file: " << filename << std::endl;
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        err << "Error: Could not open file: " << filename << std::endl;
+        return 1;
+    }
+
+    // Read straight into the buffer the interpreter will own
+    file.seekg(0, std::ios::end);
+    std::string code(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(&code[0], static_cast<std::streamsize>(code.size()));
+    if (options.debug) out << "[Jeve] File loaded, starting interpreter" << std::endl;
+    std::unique_ptr<jeve::JeveInterpreter> interpreter;
+    try {
+        interpreter = prepareInterpreter(options, settings);
+    } catch (const std::exception& e) {
+        err << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return runCode(*interpreter, filename, std::move(code), settings);
+}
+
+// Runs every script in an interpreter of its own, up to jobs at a time.
+// Each script's output is buffered and printed in command-line order as
+// soon as it and all scripts before it have finished. Returns 1 if any
+// script failed.
+int runBatch(const std::vector<std::string>& filenames, size_t jobs, const jeve::InterpreterOptions& options,
+             const RunSettings& settings) {
+    struct Result {
+        std::ostringstream out;
+        std::ostringstream err;
+        int status = 0;
+        bool finished = false;
+    };
+    std::vector<Result> results(filenames.size());
+    std::mutex printMutex;
+    size_t nextToPrint = 0;
+
+    jeve::ThreadPool pool(std::min(jobs, filenames.size()));
+    pool.parallelFor(filenames.size(), [&](size_t i) {
+        Result& result = results[i];
+        jeve::InterpreterOptions isolate = options;
+        // Scripts in a batch share the terminal, so they get no input
+        std::istringstream noInput;
+        isolate.output = &result.out;
+        isolate.errorOutput = &result.err;
+        isolate.input = &noInput;
+        if (!options.memoryLog.empty()) {
+            isolate.memoryLog = options.memoryLog + "." + std::to_string(i);
+        }
+        result.status = runFile(filenames[i], isolate, settings);
+
+        std::lock_guard<std::mutex> lock(printMutex);
+        result.finished = true;
+        while (nextToPrint < results.size() && results[nextToPrint].finished) {
+            std::cout << results[nextToPrint].out.str() << std::flush;
+            std::cerr << results[nextToPrint].err.str() << std::flush;
+            nextToPrint++;
+        }
+    });
+
+    for (const Result& result : results) {
+        if (result.status != 0) return 1;
+    }
+    return 0;
+}
+
+// Serves scripts from --client on workers that each keep an interpreter
+// prepared, with any snapshot loaded, for the next request
+int serveScripts(const std::string& socketPath, size_t workers, const jeve::InterpreterOptions& options,
+                 RunSettings settings) {
+    // A long-lived server reparses the same scripts over and over otherwise
+    settings.useCache = true;
+    try {
+        // Fail now, not on the first request, if the snapshot is unusable
+        prepareInterpreter(options, settings);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    jeve::server::Config config;
+    config.socketPath = socketPath;
+    config.workers = workers;
+    config.prepare = [&options, &settings]() { return prepareInterpreter(options, settings); };
+    config.run = [&settings](jeve::JeveInterpreter& interpreter, const std::string& name, std::string code) {
+        RunSettings script = settings;
+        // Source sent over the socket has no file to keep a cache next to
+        if (name == "<stdin>") script.useCache = false;
+        return runCode(interpreter, name, std::move(code), script);
+    };
+    return jeve::server::serve(config);
+}
+
 int main(int argc, char* argv[]) {
-    if (g_jeve_debug) std::cout << "[Jeve] Program started" << std::endl;
     if (argc < 2) {
         std::cerr << "Error: No input file specified." << std::endl;
         printUsage(argv[0]);
         return 1;
     }
 
-    // Increased default memory settings
-    size_t initialHeap = 4 * 1024 * 1024;    // 4MB
-    size_t maxHeap = 128 * 1024 * 1024;      // 128MB
-    std::string filename;
+    jeve::InterpreterOptions options;
+    options.initialHeap = 4 * 1024 * 1024;    // 4MB
+    options.maxHeap = 128 * 1024 * 1024;      // 128MB
+    RunSettings settings;
+    size_t jobs = 0;
+    bool serve = false;
+    bool client = false;
+    std::string socketPath;
+    std::vector<std::string> filenames;
     
     // Parse command line arguments
     for (int i = 1; i < argc; ++i) {
@@ -71,53 +251,186 @@ int main(int argc, char* argv[]) {
             return 0;
         } else if (arg.substr(0, 4) == "-Xms") {
             try {
-                initialHeap = parseMemorySize(arg.substr(4));
+                options.initialHeap = parseMemorySize(arg.substr(4));
             } catch (const std::exception& e) {
                 std::cerr << "Error: Invalid initial heap size format. " << e.what() << std::endl;
                 return 1;
             }
         } else if (arg.substr(0, 4) == "-Xmx") {
             try {
-                maxHeap = parseMemorySize(arg.substr(4));
+                options.maxHeap = parseMemorySize(arg.substr(4));
             } catch (const std::exception& e) {
                 std::cerr << "Error: Invalid maximum heap size format. " << e.what() << std::endl;
                 return 1;
             }
         } else if (arg == "--debug") {
-            g_jeve_debug = true;
+            options.debug = true;
+        } else if (arg.rfind("--gc=", 0) == 0) {
+            std::string mode = arg.substr(5);
+            options.incrementalGC = mode == "incremental";
+            options.concurrentGC = mode == "concurrent";
+            if (mode != "incremental" && mode != "concurrent" && mode != "generational") {
+                std::cerr << "Error: Unknown GC mode: " << mode << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--gc-slice-us=", 0) == 0) {
+            try {
+                long long micros = std::stoll(arg.substr(14));
+                if (micros < 1) throw std::invalid_argument("not positive");
+                options.gcSliceMicros = static_cast<size_t>(micros);
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid GC slice length: " << arg.substr(14) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--gc-threads=", 0) == 0) {
+            try {
+                long long count = std::stoll(arg.substr(13));
+                if (count < 1) throw std::invalid_argument("not positive");
+                options.gcThreads = static_cast<size_t>(count);
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid GC thread count: " << arg.substr(13) << std::endl;
+                return 1;
+            }
+        } else if (arg == "--gc-stats") {
+            options.gcStats = true;
+        } else if (arg == "--huge-pages") {
+            options.hugePages = true;
+        } else if (arg == "--memory-log") {
+            options.memoryLog = "memory_usage.csv";
+        } else if (arg.rfind("--memory-log=", 0) == 0) {
+            options.memoryLog = arg.substr(13);
+            if (options.memoryLog.empty()) {
+                std::cerr << "Error: --memory-log= needs a file" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--eager") {
+            options.eagerCompile = true;
+        } else if (arg.rfind("--parallel-compile-threshold=", 0) == 0) {
+            try {
+                long long threshold = std::stoll(arg.substr(29));
+                if (threshold < 0) throw std::invalid_argument("negative");
+                options.parallelCompileThreshold = static_cast<size_t>(threshold);
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid parallel compile threshold: " << arg.substr(29) << std::endl;
+                return 1;
+            }
+        } else if (arg == "--parse-only") {
+            settings.parseOnly = true;
+        } else if (arg == "--cache") {
+            settings.useCache = true;
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            settings.cacheDir = arg.substr(12);
+            if (settings.cacheDir.empty()) {
+                std::cerr << "Error: --cache-dir needs a directory" << std::endl;
+                return 1;
+            }
+            settings.useCache = true;
+        } else if (arg.rfind("--snapshot-in=", 0) == 0) {
+            settings.snapshotIn = arg.substr(14);
+            if (settings.snapshotIn.empty()) {
+                std::cerr << "Error: --snapshot-in needs a file" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--snapshot-out=", 0) == 0) {
+            settings.snapshotOut = arg.substr(15);
+            if (settings.snapshotOut.empty()) {
+                std::cerr << "Error: --snapshot-out needs a file" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if (arg.rfind("--serve=", 0) == 0) {
+            serve = true;
+            socketPath = arg.substr(8);
+        } else if (arg.rfind("--socket=", 0) == 0) {
+            socketPath = arg.substr(9);
+            if (socketPath.empty()) {
+                std::cerr << "Error: --socket needs a path" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--client") {
+            client = true;
+        } else if (arg == "-") {
+            // Source on stdin, only meaningful for --client
+            filenames.push_back(arg);
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            try {
+                long long count = std::stoll(arg.substr(7));
+                if (count < 1) throw std::invalid_argument("not positive");
+                jobs = static_cast<size_t>(count);
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid job count: " << arg.substr(7) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            try {
+                long long count = std::stoll(arg.substr(10));
+                if (count < 1) throw std::invalid_argument("not positive");
+                options.threads = static_cast<size_t>(count);
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid thread count: " << arg.substr(10) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--parallel-map-threshold=", 0) == 0) {
+            try {
+                long long threshold = std::stoll(arg.substr(25));
+                if (threshold < 0) throw std::invalid_argument("negative");
+                options.parallelMapThreshold = static_cast<size_t>(threshold);
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid parallel map threshold: " << arg.substr(25) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--parallel-sort-threshold=", 0) == 0) {
+            try {
+                long long threshold = std::stoll(arg.substr(26));
+                if (threshold < 0) throw std::invalid_argument("negative");
+                options.parallelSortThreshold = static_cast<size_t>(threshold);
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid parallel sort threshold: " << arg.substr(26) << std::endl;
+                return 1;
+            }
         } else {
-            // Assume it's the filename
-            filename = arg;
+            // Assume it's a filename
+            filenames.push_back(arg);
         }
     }
     
-    if (filename.empty()) {
+    if (serve) {
+        // jeve --serve /path/to.sock
+        if (filenames.size() == 1 && socketPath.empty()) {
+            socketPath = filenames[0];
+        } else if (!filenames.empty()) {
+            std::cerr << "Error: --serve takes no scripts" << std::endl;
+            return 1;
+        }
+        if (!settings.snapshotOut.empty()) {
+            std::cerr << "Error: --snapshot-out cannot be used with --serve" << std::endl;
+            return 1;
+        }
+        if (socketPath.empty()) socketPath = jeve::server::defaultSocketPath();
+        if (socketPath.empty()) return 1;
+        return serveScripts(socketPath, jobs, options, settings);
+    }
+
+    if (filenames.empty()) {
         std::cerr << "Error: No input file specified." << std::endl;
         printUsage(argv[0]);
         return 1;
     }
 
-    try {
-        if (g_jeve_debug) std::cout << "[Jeve] Loading file: " << filename << std::endl;
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            std::cerr << "Error: Could not open file: " << filename << std::endl;
-            return 1;
-        }
-        
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string code = buffer.str();
-        if (g_jeve_debug) std::cout << "[Jeve] File loaded, starting interpreter" << std::endl;
-        jeve::JeveInterpreter interpreter(initialHeap, maxHeap);
-        jeve::g_jeve_gc = &interpreter.getGC();
-        interpreter.interpret(code);
-        jeve::g_jeve_gc = nullptr;
-        if (g_jeve_debug) std::cout << "[Jeve] Interpreter finished" << std::endl;
-        return 0;
-    } catch (const std::exception& e) {
-        if (g_jeve_debug) std::cerr << "[Jeve] Exception: " << e.what() << std::endl;
-        std::cerr << "Error: " << e.what() << std::endl;
+    if (client) {
+        if (socketPath.empty()) socketPath = jeve::server::defaultSocketPath();
+        if (socketPath.empty()) return 1;
+        return jeve::server::runClient(socketPath, filenames);
+    }
+
+    if (filenames.size() == 1 && jobs == 0) {
+        return runFile(filenames[0], options, settings);
+    }
+    if (!settings.snapshotOut.empty()) {
+        std::cerr << "Error: --snapshot-out takes a single script" << std::endl;
         return 1;
     }
-} 
\ No newline at end of file
+    return runBatch(filenames, jobs == 0 ? 1 : jobs, options, settings);
+}
+